@@ -8,12 +8,18 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <string.h>
+#ifndef _MSC_VER
+	#include <time.h>
+#endif
 
 #include "usb_weather.h"
 #include "usb_weather_datetime.h"
 #include "usb_weather_fixed_block_1080.h"
 #include "usb_weather_message.h"
 #include "usb_weather_reading.h"
+#ifndef _MSC_VER
+	#include "usb_weather_simulator.h"
+#endif
 
 /*
 	These are the USB VID and PID of the weather station I've got
@@ -26,6 +32,92 @@
 */
 long print_fixed_block = false;
 long print_history = false;
+long print_statistics = false;
+uint32_t station_model = 1080;
+uint32_t station_number = 0;
+uint32_t benchmark_blocks = 0;
+const char *simulator_image = NULL;
+uint32_t simulator_latency = 10000;
+double simulator_failure_rate = 0.0;
+
+/*
+	TIME_IN_US()
+	------------
+	A wall clock in microseconds (from some arbitrary point)
+*/
+double time_in_us(void)
+{
+#ifdef _MSC_VER
+	LARGE_INTEGER now, frequency;
+
+	QueryPerformanceCounter(&now);
+	QueryPerformanceFrequency(&frequency);
+	return now.QuadPart * 1000000.0 / frequency.QuadPart;
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000.0 + now.tv_nsec / 1000.0;
+#endif
+}
+
+/*
+	BENCHMARK_DECODE()
+	------------------
+	usb_weather::read_many() callback that decodes both readings in each block
+*/
+void benchmark_decode(void *context, uint32_t which, const uint8_t *block)
+{
+usb_weather_reading *readings = (usb_weather_reading *)context;
+
+usb_weather::decode_reading(readings + which * 2, (const usb_weather_reading_raw *)block);
+usb_weather::decode_reading(readings + which * 2 + 1, (const usb_weather_reading_raw *)(block + 16));
+}
+
+/*
+	BENCHMARK()
+	-----------
+	Time reading (and decoding) blocks of history one transaction at a time, and then pipelined
+*/
+void benchmark(usb_weather *station, uint32_t blocks)
+{
+usb_weather_reading *readings;
+uint16_t *addresses;
+uint8_t *buffer;
+uint32_t current, got;
+double start, one_at_a_time, pipelined;
+
+addresses = new uint16_t [blocks];
+buffer = new uint8_t [blocks * 32];
+readings = new usb_weather_reading [blocks * 2];
+
+for (current = 0; current < blocks; current++)
+	addresses[current] = 0x100 + (current * 32) % (0x10000 - 0x100 - 16);
+
+start = time_in_us();
+for (got = 0; got < blocks; got++)
+	{
+	if (station->read(addresses[got], buffer + got * 32) == 0)
+		break;
+	benchmark_decode(readings, got, buffer + got * 32);
+	}
+one_at_a_time = (time_in_us() - start) / (got == 0 ? 1 : got);
+
+start = time_in_us();
+got = station->read_many(addresses, blocks, buffer, benchmark_decode, readings);
+pipelined = (time_in_us() - start) / (got == 0 ? 1 : got);
+
+puts("TRANSACTION BENCHMARK");
+puts("---------------------");
+printf("Blocks (32 bytes each)   : %u\n", (unsigned)blocks);
+printf("One at a time            : %.0f us per transaction\n", one_at_a_time);
+printf("Pipelined                : %.0f us per transaction\n", pipelined);
+printf("Speedup                  : %.2fx\n\n", one_at_a_time / (pipelined == 0 ? 1 : pipelined));
+
+delete [] readings;
+delete [] buffer;
+delete [] addresses;
+}
 
 /*
 	MANAGE_WEATHER_STATION()
@@ -33,7 +125,7 @@ long print_history = false;
 */
 void manage_weather_station(usb_weather *station)
 {
-usb_weather_reading *reading;
+usb_weather_reading *reading, **history;
 usb_weather_fixed_block_1080 *block;
 uint16_t address;
 uint16_t current;
@@ -53,26 +145,31 @@ if (print_fixed_block)
 	block->text_render();
 	puts("");
 	}
+
+/*
+	Time the transactions with the station
+*/
+if (benchmark_blocks != 0)
+	benchmark(station, benchmark_blocks);
+
 /*
 	Print the historic readings
 */
 if (print_history)
 	{
-	address = (block->current_position - 0x100) - ((block->data_count - 1) * 16);
-	address += 0x100;
-
 	puts("HISTORIC READINGS");
 	printf("-----------------");
 
-	for (current = 0; current < block->data_count - 1; current++)
+	if (block->data_count > 1)
 		{
-		reading = station->read_reading(address);
-		reading->text_render();
-		delete reading;
-
-		address += 16;
-		if (address  < 0x100)
-			address = 0x100;			// wrap around to 0x100
+		history = station->read_readings(station->history_address(block->data_count - 1), block->data_count - 1);
+		for (current = 0; current < block->data_count - 1; current++)
+			if (history[current] != NULL)
+				{
+				history[current]->text_render();
+				delete history[current];
+				}
+		delete [] history;
 		}
 	}
 
@@ -97,9 +194,18 @@ void help(void)
 puts("COMMAND LINE ARGUMENTS");
 puts("----------------------");
 puts("-?                            : display this message");
+puts("-3080                         : the station is a WH3080 (with light and UV sensors)");
 puts("-base                         : display the statistics held in the base unit (the fixed-block)");
+puts("-benchmark <blocks>           : time reading <blocks> 32-byte blocks one at a time and pipelined");
 puts("-short                        : display the current readings only [default]");
+puts("-stats                        : display the number (and latency) of transactions with the station");
+puts("-station <n>                  : use the n'th attached station (counting from 0) [default: 0]");
 puts("-history                      : display historic readings");
+#ifndef _MSC_VER
+	puts("-simulate <filename>          : use a simulated station whose memory is kept in <filename>");
+	puts("-latency <microseconds>       : how long each simulated transaction takes [default: 10000]");
+	puts("-failures <rate>              : proportion of simulated transactions that fail [default: 0]");
+#endif
 puts("");
 }
 
@@ -120,12 +226,26 @@ for (parameter = 1; parameter < argc; parameter++)
 		help();
 		return 0;
 		}
+	else if (strcmp(argv[parameter], "-3080") == 0)
+		station_model = 3080;
 	else if (strcmp(argv[parameter], "-base") == 0)
 		print_fixed_block = true;
+	else if (strcmp(argv[parameter], "-benchmark") == 0 && parameter + 1 < argc)
+		benchmark_blocks = atol(argv[++parameter]);
+	else if (strcmp(argv[parameter], "-stats") == 0)
+		print_statistics = true;
+	else if (strcmp(argv[parameter], "-station") == 0 && parameter + 1 < argc)
+		station_number = atol(argv[++parameter]);
 	else if (strcmp(argv[parameter], "-short") == 0)
 		print_history = false;
 	else if (strcmp(argv[parameter], "-history") == 0)
 		print_history = true;
+	else if (strcmp(argv[parameter], "-simulate") == 0 && parameter + 1 < argc)
+		simulator_image = argv[++parameter];
+	else if (strcmp(argv[parameter], "-latency") == 0 && parameter + 1 < argc)
+		simulator_latency = atol(argv[++parameter]);
+	else if (strcmp(argv[parameter], "-failures") == 0 && parameter + 1 < argc)
+		simulator_failure_rate = atof(argv[++parameter]);
 	else
 		{
 		help();
@@ -133,9 +253,34 @@ for (parameter = 1; parameter < argc; parameter++)
 		}
 	}
 
-station = new usb_weather;
-if ((connect_error = station->connect(USB_WEATHER_VID, USB_WEATHER_PID)) == 0)
+#ifndef _MSC_VER
+	if (simulator_image != NULL)
+		{
+		usb_weather_simulator *simulator = new usb_weather_simulator;
+
+		station = simulator;
+		simulator->set_model(station_model);
+		simulator->set_latency(simulator_latency);
+		if ((connect_error = simulator->connect(simulator_image)) == 0)
+			simulator->set_failure_rate(simulator_failure_rate);
+		}
+	else
+#endif
+	{
+	station = new usb_weather;
+	station->set_model(station_model);
+	connect_error = station->connect(USB_WEATHER_VID, USB_WEATHER_PID, station_number);
+	}
+
+if (connect_error == 0)
+	{
 	manage_weather_station(station);
+	if (print_statistics)
+		{
+		puts("");
+		station->get_statistics()->text_render();
+		}
+	}
 else
 	{
 	printf("Cannot find an attached weather station, Error:%d\n", connect_error);
@@ -13,8 +13,18 @@
 #include <sstream>
 
 #include "usb_weather_cache.h"
+#ifndef _MSC_VER
+	#include <unistd.h>
+	#include "usb_weather_client.h"
+	#include "usb_weather_manager.h"
+	#include "usb_weather_shared.h"
+	#include "weather_fastcgi_server.h"
+	#include "weather_http_server.h"
+	#include "weather_page_cache.h"
+#endif
 #include "usb_weather_datetime.h"
 #include "usb_weather_fixed_block_1080.h"
+#include "usb_weather_history.h"
 #include "usb_weather_message.h"
 #include "usb_weather_reading.h"
 #include "weather_math.h"
@@ -40,7 +50,7 @@ enum {NONE = 0, OUTSIDE_TEMPERATURE = 0x01, INSIDE_TEMPERATURE = 0x02, OUTSIDE_H
 /*
 	Prototypes
 */
-usb_weather_reading **render_historic_readings(usb_weather *station, uint32_t what_to_render);
+void render_historic_readings(usb_weather *station, uint32_t what_to_render);
 long get_readings_at_time(usb_weather *station, usb_weather_reading *answer, long search_time_hour, long search_time_mins);
 
 /*
@@ -73,11 +83,20 @@ usb_weather_reading three_pm;
 std::ostringstream json;
 
 if ((readings = station->read_current_readings()) == NULL)
-	exit(printf("{\"error\":\"Cannot read current readings\"}"));
+	{
+	printf("{\"error\":\"Cannot read current readings\"}");
+	return NULL;
+	}
 
 json << std::setprecision(2) << std::fixed;
 json << "{\n";
 
+if (readings->has_solar)
+	{
+	json << "\"light\":" << readings->light << ",\n";
+	json << "\"uv\":" << (int)readings->uv << ",\n";
+	}
+
 long_deltas = station->read_hourly_delta();				// "near-hour" deltas
 deltas = station->interpolate_hourly_delta(long_deltas);	// interpolate "near-hour" deltas into hourly deltas
 got_high_low = station->read_highs_and_lows(&highs, &lows);
@@ -189,6 +208,10 @@ json << "\"error\":\"none\"\n";
 json << "}\n";
 
 std::cout << json.str();
+
+delete deltas;
+delete long_deltas;
+
 return readings;
 }
 
@@ -478,7 +501,10 @@ double minimum_grass_temp;
 usb_weather_reading three_pm;
 
 if ((readings = station->read_current_readings()) == NULL)
-	exit(printf("Cannot read current readings\n"));
+	{
+	printf("Cannot read current readings\n");
+	return NULL;
+	}
 
 long_deltas = station->read_hourly_delta();				// "near-hour" deltas
 deltas = station->interpolate_hourly_delta(long_deltas);	// interpolate "near-hour" deltas into hourly deltas
@@ -619,6 +645,9 @@ puts("</table>");
 
 render_html_tail_iphone();
 
+delete deltas;
+delete long_deltas;
+
 return readings;
 }
 
@@ -693,7 +722,7 @@ printf("}\n\n");
 */
 long get_readings_at_time(usb_weather *station, usb_weather_reading *answer, long search_time_hour, long search_time_mins)
 {
-usb_weather_reading **history;
+usb_weather_history history;
 long current;
 uint32_t readings;
 usb_weather_fixed_block_1080 *fixed_block;
@@ -716,7 +745,7 @@ mins_since_midnight = hour * 60 + minute;
 	get the readings for the last 25 hours, that way we can guarnatee to get the last reading the the specified time
 */
 readings_wanted = (60 * 25) / fixed_block->read_period;
-if ((history = station->read_all_readings(&readings, readings_wanted)) == NULL)
+if ((readings = station->read_history(&history, readings_wanted)) == 0)
 	return false;
 
 /*
@@ -727,19 +756,16 @@ timeline = new long [readings];
 sum = 0;
 for (current = readings - 1; current >= 0; current--)
 	{
-	if (history[current] != NULL)
-		{
-		if (!history[current]->lost_communications)
-			timeline[current] = sum;
-		sum += history[current]->delay;
-		}
+	if (!history.lost_communications[current])
+		timeline[current] = sum;
+	sum += history.delay[current];
 	}
 
 /*
 	Find the give time (working backwards from now)
 */
 for (current = 0; current < readings; current++)
-	if (history[current] != NULL && !history[current]->lost_communications)
+	if (!history.lost_communications[current])
 		{
 		long hours, mins, when;
 
@@ -751,7 +777,7 @@ for (current = 0; current < readings; current++)
 
 		if (abs((int)(search_mins - (hours * 60 + mins))) < search_best_mins)
 			{
-			*answer = *history[current];
+			history.get(current, answer);
 			search_best_mins = abs((int)(search_mins - (hours * 60 + mins)));
 			found = true;
 			}
@@ -771,12 +797,12 @@ return found;
 	RENDER_HISTORIC_READINGS()
 	--------------------------
 */
-usb_weather_reading **render_historic_readings(usb_weather *station, uint32_t what_to_render)
+void render_historic_readings(usb_weather *station, uint32_t what_to_render)
 {
 long sum;
 long *timeline;
 double *data;
-usb_weather_reading **history;
+usb_weather_history history;
 long current, bucket;
 uint32_t readings;
 usb_weather_fixed_block_1080 *fixed_block;
@@ -790,8 +816,11 @@ mins_since_midnight = hour * 60 + minute;
 
 readings_wanted = (mins_since_midnight + (60 * 24)) / fixed_block->read_period;
 
-if ((history = station->read_all_readings(&readings, readings_wanted)) == NULL)
-	exit(printf("Cannot read historic readings\n"));
+if ((readings = station->read_history(&history, readings_wanted)) == 0)
+	{
+	printf("Cannot read historic readings\n");
+	return;
+	}
 
 timeline = new long [readings];
 data = new double [readings];
@@ -804,32 +833,32 @@ if ((what_to_render & RAINFALL) != 0)
 	sum = 0;
 	for (current = readings - 1; current >= 1; current--)
 		{
-		printf("%2.2f\n", history[current]->total_rain);
-		if (!history[current]->lost_communications)
+		printf("%2.2f\n", history.total_rain[current]);
+		if (!history.lost_communications[current])
 			{
 			timeline[current] = sum;
-			if (history[current]->total_rain == history[current - 1]->total_rain)
+			if (history.total_rain[current] == history.total_rain[current - 1])
 				data[current] = 0;
 			else
 				{
-				printf("%2.2f != %2.2f\n", history[current]->total_rain, history[current - 2]->total_rain);
+				printf("%2.2f != %2.2f\n", history.total_rain[current], history.total_rain[current - 2]);
 				/*
 					We've seen rain, so first find the rain guage level at the begining of the shower
 				*/
-				initial_rain = history[0]->total_rain;
+				initial_rain = history.total_rain[0];
 				for (bucket = current; bucket >= 1; bucket--)
-					if (history[bucket]->total_rain == history[bucket - 1]->total_rain)
+					if (history.total_rain[bucket] == history.total_rain[bucket - 1])
 						{
-						initial_rain = history[bucket]->total_rain;
+						initial_rain = history.total_rain[bucket];
 						break;
 						}
 				/*
 					Now compute this shower's amount
 				*/
-				data[current] = history[current]->total_rain - initial_rain;		// initial_rain is the cumulative rain (to date) *after* the shower
+				data[current] = history.total_rain[current] - initial_rain;		// initial_rain is the cumulative rain (to date) *after* the shower
 				}
 			}
-		sum += history[current]->delay;
+		sum += history.delay[current];
 		}
 	render_html_graph("rain", "Rainfall", "Time", "Millimetres", readings, timeline, data, mins_since_midnight);
 	}
@@ -842,27 +871,27 @@ sum = 0;
 for (current = readings - 1; current >= 0; current--)
 	{
 	timeline[current] = sum;
-	sum += history[current]->delay;
+	sum += history.delay[current];
 	}
 
 if ((what_to_render & INSIDE_TEMPERATURE) != 0)
 	{
 	for (current = readings - 1; current >= 0; current--)
-		data[current] = history[current]->indoor_temperature;
+		data[current] = history.indoor_temperature[current];
 	render_html_graph("indoor_temperature", "Inside Temperature", "Time", "Degrees C", readings, timeline, data, mins_since_midnight);
 	}
 
 if ((what_to_render & INSIDE_HUMIDITY) != 0)
 	{
 	for (current = readings - 1; current >= 0; current--)
-		data[current] = history[current]->indoor_humidity;
+		data[current] = history.indoor_humidity[current];
 	render_html_graph("indoor_humidity", "Inside Humidity", "Time", "Percent", readings, timeline, data, mins_since_midnight);
 	}
 
 if ((what_to_render & PRESSURE) != 0)
 	{
 	for (current = readings - 1; current >= 0; current--)
-		data[current] = history[current]->absolute_pressure;
+		data[current] = history.absolute_pressure[current];
 	render_html_graph("pressure", "Pressure", "Time", "Hectopascals", readings, timeline, data, mins_since_midnight);
 	}
 
@@ -872,40 +901,40 @@ if ((what_to_render & PRESSURE) != 0)
 sum = 0;
 for (current = readings - 1; current >= 0; current--)
 	{
-	if (!history[current]->lost_communications)
+	if (!history.lost_communications[current])
 		timeline[current] = sum;
-	sum += history[current]->delay;
+	sum += history.delay[current];
 	}
 
 if ((what_to_render & OUTSIDE_TEMPERATURE) != 0)
 	{
 	for (current = readings - 1; current >= 0; current--)
-		if (!history[current]->lost_communications)
-			data[current] = history[current]->outdoor_temperature;
+		if (!history.lost_communications[current])
+			data[current] = history.outdoor_temperature[current];
 	render_html_graph("outdoor_temperature", "Outside Temperature", "Time", "Degrees C", readings, timeline, data, mins_since_midnight);
 	}
 
 if ((what_to_render & OUTSIDE_HUMIDITY) != 0)
 	{
 	for (current = readings - 1; current >= 0; current--)
-		if (!history[current]->lost_communications)
-			data[current] = history[current]->outdoor_humidity;;
+		if (!history.lost_communications[current])
+			data[current] = history.outdoor_humidity[current];;
 	render_html_graph("outdoor_humidity", "Outside Humidity", "Time", "Percent", readings, timeline, data, mins_since_midnight);
 	}
 
 if ((what_to_render & WINDSPEED) != 0)
 	{
 	for (current = readings - 1; current >= 0; current--)
-		if (!history[current]->lost_communications)
-			data[current] = weather_math::knots(history[current]->average_windspeed);
+		if (!history.lost_communications[current])
+			data[current] = weather_math::knots(history.average_windspeed[current]);
 	render_html_graph("windspeed", "Average Wind Speed", "Time", "Knots", readings, timeline, data, mins_since_midnight);
 	}
 
 if ((what_to_render & WINDGUST) != 0)
 	{
 	for (current = readings - 1; current >= 0; current--)
-		if (!history[current]->lost_communications)
-			data[current] = weather_math::knots(history[current]->gust_windspeed);
+		if (!history.lost_communications[current])
+			data[current] = weather_math::knots(history.gust_windspeed[current]);
 	render_html_graph("gust", "Wind Gust", "Time", "Knots", readings, timeline, data, mins_since_midnight);
 	}
 
@@ -913,7 +942,8 @@ if ((what_to_render & WINDGUST) != 0)
 	uint8_t  wind_direction;			// multiply by 22.5 to get degrees from north
 */
 
-return history;
+delete [] data;
+delete [] timeline;
 }
 
 
@@ -924,16 +954,12 @@ return history;
 */
 void render_historic_readings_json(usb_weather *station)
 {
-long sum;
-long *timeline;
-double *data;
-usb_weather_reading **history;
-long current, bucket;
+usb_weather_history history;
+long current;
 uint32_t readings;
 usb_weather_fixed_block_1080 *fixed_block;
 uint8_t year, month, day, hour, minute;
 long mins_since_midnight, readings_wanted;
-double initial_rain;
 
 fixed_block = station->read_fixed_block();
 fixed_block->current_time.extract(&year, &month, &day, &hour, &minute);
@@ -941,7 +967,7 @@ mins_since_midnight = hour * 60 + minute;
 
 readings_wanted = (mins_since_midnight + (60 * 24)) / fixed_block->read_period;
 
-if ((history = station->read_all_readings(&readings, readings_wanted)) == NULL)
+if ((readings = station->read_history(&history, readings_wanted)) == 0)
 	printf("{\"error\":\"Cannot read historic readings\"}");
 else
 	{
@@ -949,17 +975,22 @@ else
 	printf("\"sample\":[\n");
 	uint32_t age = 0;
 	for (current = readings - 1; current >= 0; current--)
-		if (!history[current]->lost_communications)
+		if (!history.lost_communications[current])
 			{
 			printf("{\n");
 			printf("\"age\":%d,\n", age);		// in minutes
-			age += history[current]->delay;	// delay in minutes to the *next* reading
-			printf("\"humidity\":%.2f,\n", history[current]->outdoor_humidity);
-			printf("\"temperature\":%.2f,\n", history[current]->outdoor_temperature);
-			printf("\"pressuresealevel\":%.2f,\n", history[current]->absolute_pressure);
-			printf("\"windspeed\":%.2f,\n", weather_math::knots(history[current]->average_windspeed));
-			printf("\"windgusts\":%.2f,\n", weather_math::knots(history[current]->gust_windspeed));
-			printf("\"raintotal\":%.2f\n", history[current]->total_rain);
+			age += history.delay[current];	// delay in minutes to the *next* reading
+			printf("\"humidity\":%.2f,\n", history.outdoor_humidity[current]);
+			printf("\"temperature\":%.2f,\n", history.outdoor_temperature[current]);
+			printf("\"pressuresealevel\":%.2f,\n", history.absolute_pressure[current]);
+			printf("\"windspeed\":%.2f,\n", weather_math::knots(history.average_windspeed[current]));
+			printf("\"windgusts\":%.2f,\n", weather_math::knots(history.gust_windspeed[current]));
+			if (history.has_solar)
+				{
+				printf("\"light\":%.2f,\n", history.light[current]);
+				printf("\"uv\":%d,\n", history.uv[current]);
+				}
+			printf("\"raintotal\":%.2f\n", history.total_rain[current]);
 			if (current != 0)
 				printf("},\n");
 			else
@@ -972,73 +1003,446 @@ else
 }
 
 /*
-	MAIN()
-	------
+	RENDER_PAGE()
+	-------------
+	Render whatever the query string asks for
 */
-int main(int argc, char *argv[])
+int render_page(usb_weather *station, const char *query_string)
+{
+if (query_string != NULL)
+	{
+	if (strstr(query_string, "JSON"))
+		{
+		puts("Content-type: application/json; charset=utf-8\n");
+		if (strstr(query_string, "historic"))
+			render_historic_readings_json(station);
+		else
+			delete render_current_readings_json(station);
+		return 0;
+		}
+
+	puts("Content-type: text/html\n");
+	if (strstr(query_string, "temperature") != NULL)
+		return render_historic_readings_iphone(station, OUTSIDE_TEMPERATURE);
+	else if (strstr(query_string, "wind") != NULL)
+		return render_historic_readings_iphone(station, WINDSPEED | WINDGUST);
+	else if (strstr(query_string, "rain") != NULL)
+		return render_historic_readings_iphone(station, RAINFALL);
+	else if (strstr(query_string, "humidity") != NULL)
+		return render_historic_readings_iphone(station, OUTSIDE_HUMIDITY);
+	else if (strstr(query_string, "pressure") != NULL)
+		return render_historic_readings_iphone(station, PRESSURE);
+	}
+
+delete render_current_readings_iphone(station);
+return 0;
+}
+
+/*
+	class STATION_CONNECTION
+	------------------------
+	How we got to the station (see connect_station()).  When we're serving more than one page it's kept between them.
+*/
+class station_connection
+{
+public:
+	long number;						// which station (counting from 0)
+	usb_weather *station;				// the daemon or local (NULL if we haven't connected)
+	usb_weather *daemon;				// the daemon (if it's running)
+	usb_weather_cache *local;			// our own cache over the USB (if we went to the station ourselves)
+	uint32_t code;						// why we couldn't connect (as for usb_weather::connect())
+#ifndef _MSC_VER
+	usb_weather_shared *shared;			// what the owner of the station has published (NULL if we can't get at it)
+	weather_page_cache pages;			// pages already rendered (when we're serving more than one)
+#endif
+} ;
+
+/*
+	DISCONNECT_STATION()
+	--------------------
+*/
+void disconnect_station(station_connection *connection)
+{
+delete connection->daemon;
+delete connection->local;
+connection->station = connection->daemon = connection->local = NULL;
+}
+
+/*
+	CONNECT_STATION()
+	-----------------
+	Connect to the station: if the daemon is running then it owns the weather station so ask it, otherwise go
+	to the station ourselves.  Returns the station, or NULL (with the reason in the connection's code).
+*/
+usb_weather *connect_station(void *context)
+{
+station_connection *connection;
+char *model;
+
+connection = (station_connection *)context;
+model = getenv("WEATHER_STATION_MODEL");			// 3080 for a WH3080 (the default is 1080)
+
+/*
+	Still connected from the last page?  If so bring it up to date.
+*/
+if (connection->station != NULL)
+	{
+	if (connection->station == connection->local ? connection->local->sync() >= 0 : connection->station->reload_fixed_block() != NULL)
+		return connection->station;
+	disconnect_station(connection);
+	}
+
+#ifndef _MSC_VER
+	usb_weather_client *daemon;
+	char socket_name[1024], cache_name[1024];
+
+	usb_weather_manager::station_name(socket_name, sizeof(socket_name), USB_WEATHER_SERVER_SOCKET, connection->number);
+	usb_weather_manager::station_name(cache_name, sizeof(cache_name), USB_WEATHER_CACHE_FILE, connection->number);
+	connection->daemon = daemon = new usb_weather_client;
+	if ((connection->code = daemon->connect(socket_name)) == 0)
+		{
+		if (model != NULL)
+			daemon->set_model(atol(model));
+		return connection->station = daemon;
+		}
+#endif
+
+connection->local = new usb_weather_cache;
+if (model != NULL)
+	connection->local->set_model(atol(model));
+#ifndef _MSC_VER
+	connection->local->attach(cache_name);			// if we can't keep the cache in a file then we do without
+#endif
+if ((connection->code = connection->local->connect(USB_WEATHER_VID, USB_WEATHER_PID, connection->number)) != 0)
+	{
+	disconnect_station(connection);
+	return NULL;
+	}
+
+connection->local->sync(true);
+return connection->station = connection->local;
+}
+
+/*
+	RENDER_ERROR_PAGE()
+	-------------------
+	We couldn't get to the station (code is as for usb_weather::connect())
+*/
+void render_error_page(uint32_t code)
+{
+puts("Content-type: text/html\n");
+
+render_html_head_iphone(NULL, NONE);
+puts("<body background=/background.jpg>");
+switch (code)
+	{
+	case 1:
+		printf("Cannot connect to the attached weather station<br>");
+		break;
+	case 2:
+		printf("Cannot find an attached weather station<br>");
+		break;
+	case 3:
+		printf("Cannot read from the attached weather station<br>");
+		break;
+	case 4:
+		printf("Weather station is currently busy<br>");
+		break;
+	default:
+		printf("Cannot find an attached weather station<br>");
+		break;
+	}
+
+render_html_tail_iphone();
+}
+
+/*
+	OPEN_STATION()
+	--------------
+	Get to the station for a page.  Returns the station, or NULL (with the reason in the connection's code).
+*/
+usb_weather *open_station(station_connection *connection)
+{
+#ifndef _MSC_VER
+	/*
+		If whoever owns the station (the daemon, or another of us) has published it recently enough then read
+		that (without going near the station or its lock), otherwise go to the station
+	*/
+	if (connection->shared != NULL && connection->shared->connect(connect_station, connection) == 0)
+		return connection->shared;
+#endif
+
+return connect_station(connection);
+}
+
+/*
+	SERVE_PAGE()
+	------------
+	Write the page the query string asks for (from station, as got by open_station()) to stdout (as a CGI program
+	does).  Returns the exit code.
+*/
+int serve_page(station_connection *connection, usb_weather *station, const char *query_string)
+{
+int result = 0;
+
+if (station == NULL)
+	render_error_page(connection->code);
+else
+	{
+	result = render_page(station, query_string);
+
+	/*
+		"stats" anywhere in the query puts what it took to talk to the station into the web server's error log
+	*/
+	if (query_string != NULL && strstr(query_string, "stats") != NULL)
+		station->get_statistics()->text_render(stderr);
+	}
+
+#ifndef _MSC_VER
+	/*
+		If we went to the station ourselves then everyone else can have what we now know
+	*/
+	if (connection->shared != NULL && connection->station != NULL && connection->station == connection->local)
+		connection->shared->publish(connection->local);
+#endif
+
+return result;
+}
+
+/*
+	SERVE()
+	-------
+	Write the page the query string asks for to stdout (as a CGI program does).  Returns the exit code.
+*/
+int serve(station_connection *connection, const char *query_string)
 {
-usb_weather_cache station;
-usb_weather_reading *current = NULL;
-usb_weather_reading **historic = NULL;
-char *query_string;
-long code;
+return serve_page(connection, open_station(connection), query_string);
+}
 
-if ((code = station.connect(USB_WEATHER_VID, USB_WEATHER_PID)) == 0)
+#ifndef _MSC_VER
+	/*
+		STATION_VERSION()
+		-----------------
+		Every page is rendered from the fixed block (which has the station's clock in it) and the history ring, and
+		the ring only changes when the station writes its current record (every 48 seconds) or moves on to the
+		next.  So between them the fixed block and the current record say what the station looks like.  Returns
+		false if we can't tell.
+	*/
+	long station_version(usb_weather *station, std::string *version)
 	{
-	if ((query_string = getenv("QUERY_STRING")) != NULL)
+	usb_weather_fixed_block_1080 *fixed_block;
+	uint8_t current[32];
+
+	if ((fixed_block = station->read_fixed_block()) == NULL || station->read(fixed_block->current_position, current) != sizeof(current))
+		return false;
+
+	version->assign((char *)fixed_block, sizeof(*fixed_block));
+	version->append((char *)current, station->get_record_size());
+
+	return true;
+	}
+
+	/*
+		PAGE_VALIDATOR()
+		----------------
+		The entity tag of the page called name (see render_request()) when the station is at version: a hash of
+		the two (64-bit FNV-1a) in quotes.
+	*/
+	void page_validator(char *into, size_t length, const std::string *name, const std::string *version)
+	{
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	size_t at;
+
+	for (at = 0; at < name->size(); at++)
+		hash = (hash ^ (uint8_t)(*name)[at]) * 0x100000001B3ULL;
+	hash = (hash ^ 0xFF) * 0x100000001B3ULL;			// so that no name and version run into the next
+	for (at = 0; at < version->size(); at++)
+		hash = (hash ^ (uint8_t)(*version)[at]) * 0x100000001B3ULL;
+
+	snprintf(into, length, "\"%016llx\"", (unsigned long long)hash);
+	}
+
+	/*
+		RENDER_REQUEST()
+		----------------
+		Answer a request from weather_http_server (or weather_fastcgi_server).  The page is written to stdout just
+		as it is for a CGI program (see serve_pages()) then read back into response.  If the station hasn't changed
+		since we last rendered the page then we send that again (compressed, if the client takes that), and if
+		the client already has it we say so (with a 304) rather than send it at all.
+	*/
+	void render_request(void *context, const weather_http_request *request, std::string *response)
+	{
+	station_connection *connection;
+	usb_weather *station;
+	std::string name, version, validators, tag, rendered;
+	char etag[32], last_modified[64];
+	const char *encoding;
+	time_t changed;
+	off_t length;
+
+	connection = (station_connection *)context;
+	setenv("SCRIPT_NAME", request->path.c_str(), true);
+	if (request->user_agent.empty())
+		unsetenv("HTTP_USER_AGENT");
+	else
+		setenv("HTTP_USER_AGENT", request->user_agent.c_str(), true);
+
+	/*
+		The page depends on the query, the links in it on the path, and the fonts on whether it's for Internet
+		Explorer.  "stats" is always rendered as what it costs to render the page is the point.
+	*/
+	name = request->query_string + '\n' + request->path + (strstr(request->user_agent.c_str(), "MSIE") != NULL ? "\nMSIE" : "");
+	encoding = request->encoding();
+	station = open_station(connection);
+	if (station != NULL && strstr(request->query_string.c_str(), "stats") == NULL && station_version(station, &version))
 		{
-		if (strstr(query_string, "JSON"))
+		changed = connection->pages.changed(&version);
+		tag = encoding == NULL ? name : name + '\n' + encoding;		// each compression of the page is a different set of bytes
+		page_validator(etag, sizeof(etag), &tag, &version);
+		weather_http_request::format_date(last_modified, sizeof(last_modified), changed);
+		validators = std::string("ETag: ") + etag + "\nLast-Modified: " + last_modified + "\nVary: Accept-Encoding\n";
+
+		if ((request->method == "GET" || request->method == "HEAD") && request->not_modified(etag, changed))
 			{
-			puts("Content-type: application/json; charset=utf-8\n");
-			if (strstr(query_string, "historic"))
-				render_historic_readings_json(&station);
-			else
-				render_current_readings_json(&station);
-			return 0;
+			*response = "Status: 304 Not Modified\n" + validators + "\n";
+			return;
 			}
 
-		puts("Content-type: text/html\n");
-		if (strstr(query_string, "temperature") != NULL)
-			return render_historic_readings_iphone(&station, OUTSIDE_TEMPERATURE);
-		else if (strstr(query_string, "wind") != NULL)
-			return render_historic_readings_iphone(&station, WINDSPEED | WINDGUST);
-		else if (strstr(query_string, "rain") != NULL)
-			return render_historic_readings_iphone(&station, RAINFALL);
-		else if (strstr(query_string, "humidity") != NULL)
-			return render_historic_readings_iphone(&station, OUTSIDE_HUMIDITY);
-		else if (strstr(query_string, "pressure") != NULL)
-			return render_historic_readings_iphone(&station, PRESSURE);
+		if (connection->pages.find(&name, &version, encoding, response))
+			{
+			response->insert(0, validators);
+			return;
+			}
 		}
-		
-	render_current_readings_iphone(&station);
+	else
+		version.clear();
+
+	fflush(stdout);
+	if (ftruncate(STDOUT_FILENO, 0) != 0 || lseek(STDOUT_FILENO, 0, SEEK_SET) != 0)
+		{
+		*response = "Status: 500 Internal Server Error\nContent-type: text/plain\n\nCannot render the page\n";
+		return;
+		}
+
+	serve_page(connection, station, request->query_string.c_str());
+	std::cout.flush();
+	fflush(stdout);
+
+	length = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+	response->resize(length < 0 ? 0 : length);
+	if (length > 0 && pread(STDOUT_FILENO, &(*response)[0], length, 0) != length)
+		response->clear();
+
+	if (!version.empty() && !response->empty())
+		{
+		rendered.swap(*response);
+		connection->pages.store(&name, &version, &rendered, encoding, response);
+		response->insert(0, validators);
+		}
+	else if (strstr(request->query_string.c_str(), "stats") != NULL)
+		fprintf(stderr, "Pages: %u from the cache, %u rendered\n", connection->pages.get_hits(), connection->pages.get_misses());
 	}
-else
+
+	/*
+		SERVE_PAGES()
+		-------------
+		Answer the server's requests forever.  The pages are written to stdout (as for a CGI program), so point that
+		somewhere they can be read back from.  Returns the exit code.
+	*/
+	int serve_pages(weather_http_server *server)
 	{
-	puts("Content-type: text/html\n");
-	
-	render_html_head_iphone(NULL, NONE);
-	puts("<body background=/background.jpg>");
-	switch (code)
+	FILE *pages;
+
+	if ((pages = tmpfile()) == NULL || dup2(fileno(pages), STDOUT_FILENO) < 0)
 		{
-		case 1:
-			printf("Cannot connect to the attached weather station<br>");
-			break;
-		case 2:
-			printf("Cannot find an attached weather station<br>");
-			break;
-		case 3:
-			printf("Cannot read from the attached weather station<br>");
-			break;
-		case 4:
-			printf("Weather station is currently busy<br>");
-			break;
-		default:
-			printf("Cannot find an attached weather station<br>");
-			break;
+		fprintf(stderr, "Cannot make somewhere to render pages\n");
+		return 1;
 		}
 
-	render_html_tail_iphone();
+	return server->run();
 	}
 
-return 0;
+	/*
+		SERVE_HTTP()
+		------------
+		Be a web server on the given port (rather than a CGI program), keeping the station between pages.  Returns
+		the exit code.
+	*/
+	int serve_http(station_connection *connection, uint16_t port)
+	{
+	weather_http_server server(render_request, connection);
+	uint32_t error;
+
+	if ((error = server.listen(port)) != 0)
+		{
+		fprintf(stderr, "Cannot listen on port %u, Error:%u\n", (unsigned)port, error);
+		return 1;
+		}
+
+	return serve_pages(&server);
+	}
+
+	/*
+		SERVE_FASTCGI()
+		---------------
+		Be a FastCGI program behind Apache or nginx, keeping the station between pages.  Take the web server's
+		connections on the given port, or (if port is 0) from the socket the web server started us with.  Returns
+		the exit code.
+	*/
+	int serve_fastcgi(station_connection *connection, uint16_t port)
+	{
+	weather_fastcgi_server server(render_request, connection);
+	uint32_t error;
+
+	if ((error = port == 0 ? server.adopt(weather_fastcgi_server::LISTEN_SOCKET) : server.listen(port)) != 0)
+		{
+		fprintf(stderr, "Cannot take FastCGI requests, Error:%u\n", error);
+		return 1;
+		}
+
+	return serve_pages(&server);
+	}
+#endif
+
+/*
+	MAIN()
+	------
+	Run as a CGI program (by the web server), with -listen <port> as a web server of our own, or as a FastCGI
+	program (with -fastcgi [port], or when the web server starts us that way)
+*/
+int main(int argc, char *argv[])
+{
+station_connection connection;
+char *which;
+int result;
+
+/*
+	Which station (if there's more than one) counting from 0
+*/
+connection.number = (which = getenv("WEATHER_STATION")) == NULL ? 0 : atol(which);
+connection.station = connection.daemon = connection.local = NULL;
+connection.code = 0;
+
+#ifndef _MSC_VER
+	usb_weather_shared shared;
+	char shared_name[1024], *model;
+
+	usb_weather_manager::station_name(shared_name, sizeof(shared_name), USB_WEATHER_SHARED_NAME, connection.number);
+	if ((model = getenv("WEATHER_STATION_MODEL")) != NULL)
+		shared.set_model(atol(model));
+	connection.shared = shared.attach(shared_name) == 0 ? &shared : NULL;
+
+	if (argc == 3 && strcmp(argv[1], "-listen") == 0)
+		result = serve_http(&connection, (uint16_t)atol(argv[2]));
+	else if (argc >= 2 && strcmp(argv[1], "-fastcgi") == 0)
+		result = serve_fastcgi(&connection, argc >= 3 ? (uint16_t)atol(argv[2]) : 0);
+	else if (weather_fastcgi_server::launched_by_web_server())
+		result = serve_fastcgi(&connection, 0);
+	else
+#endif
+	result = serve(&connection, getenv("QUERY_STRING"));
+
+disconnect_station(&connection);
+
+return result;
 }
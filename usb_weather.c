@@ -5,9 +5,12 @@
 	Licensed BSD
 */
 #include <float.h>
+#include <stddef.h>
 #include <errno.h>
 #include <stdlib.h>
 #include "usb_weather.h"
+#include "usb_weather_history.h"
+#include "usb_weather_model.h"
 #include "usb_weather_message.h"
 #include "usb_weather_reading_raw.h"
 
@@ -21,12 +24,26 @@
 #elif defined (__APPLE__)
 	#include <queue>
 #else
-	#include <linux/hidraw.h>
-	#include <sys/ioctl.h>
 	#include <sys/file.h>
+	#include <dirent.h>
 	#include <fcntl.h>	
+	#include <poll.h>
 	#include <stdio.h>
+	#include <time.h>
 	#include <unistd.h>
+
+	/*
+		Where the hidraw devices are, and where the kernel tells us about them
+	*/
+	#ifndef USB_WEATHER_DEV
+		#define USB_WEATHER_DEV "/dev"
+	#endif
+	#ifndef USB_WEATHER_SYSFS_HIDRAW
+		#define USB_WEATHER_SYSFS_HIDRAW "/sys/class/hidraw"
+	#endif
+#endif
+#ifndef _MSC_VER
+	#include <sys/stat.h>
 #endif
 #include <string.h>
 
@@ -79,6 +96,16 @@ usb_weather::usb_weather()
 {
 hDevice = INVALID_HANDLE_VALUE;
 fixed_block = NULL;
+timeout_in_ms = 1000;
+flush_before_next = false;
+model = 1080;
+vid = pid = which = 0;
+#ifndef _MSC_VER
+	hid_report_number = 0;
+#endif
+#if !defined(_MSC_VER) && !defined(__APPLE__)
+	device_path[0] = '\0';
+#endif
 }
 
 /*
@@ -87,6 +114,17 @@ fixed_block = NULL;
 */
 usb_weather::~usb_weather()
 {
+disconnect();
+delete fixed_block;
+}
+
+/*
+	USB_WEATHER::DISCONNECT()
+	-------------------------
+	Let go of the device
+*/
+void usb_weather::disconnect(void)
+{
 if (hDevice != INVALID_HANDLE_VALUE)
 	{
 	#ifdef _MSC_VER
@@ -96,17 +134,49 @@ if (hDevice != INVALID_HANDLE_VALUE)
 	#else
 		flock(hDevice, LOCK_UN);
 		close(hDevice);
+		device_path[0] = '\0';
 	#endif
 	}
+hDevice = INVALID_HANDLE_VALUE;
+}
+
+/*
+	USB_WEATHER::RECONNECT()
+	------------------------
+	Let go of the device and connect() again to the same station (after it has been unplugged and plugged back in).
+	Return an error code (or 0 for success), as for connect()
+*/
+uint32_t usb_weather::reconnect(void)
+{
+disconnect();
 delete fixed_block;
+fixed_block = NULL;
+flush_before_next = false;
+
+return connect(vid, pid, which);
+}
+
+/*
+	USB_WEATHER::GET_DEVICE_PATH()
+	------------------------------
+	The name of the device we're connected to (or "" if we don't know it)
+*/
+const char *usb_weather::get_device_path(void)
+{
+#if defined(_MSC_VER) || defined(__APPLE__)
+	return "";
+#else
+	return device_path;
+#endif
 }
 
 #ifdef _MSC_VER
 	/*
 		USB_WEATHER::CONNECT()
 		----------------------
+		Connect to the which'th (counting from 0) attached station with the given VID and PID
 	*/
-	uint32_t usb_weather::connect(uint32_t vid, uint32_t pid)
+	uint32_t usb_weather::connect(uint32_t vid, uint32_t pid, uint32_t which)
 	{
 	GUID guid;
 	HDEVINFO hDevInfo;
@@ -116,6 +186,11 @@ delete fixed_block;
 	SP_DEVICE_INTERFACE_DETAIL_DATA *detail_data = NULL;
 	HIDD_ATTRIBUTES attributes;
 	long found = false;
+	uint32_t matched = 0;
+
+	this->vid = vid;
+	this->pid = pid;
+	this->which = which;
 
 	/*
 		Get the GUID of the Windows HID class so that we can identify HID devices
@@ -154,12 +229,12 @@ delete fixed_block;
 			{
 			if ((hDevice = CreateFile(detail_data->DevicePath, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL)) != INVALID_HANDLE_VALUE)
 				{
-				COMMTIMEOUTS timeout = {1000, 0, 1000, 0, 1000};		// reads and writes timeout in one second
+				COMMTIMEOUTS timeout = {timeout_in_ms, 0, timeout_in_ms, 0, timeout_in_ms};		// reads and writes timeout
 
 				SetCommTimeouts(hDevice, &timeout);
 				attributes.Size = sizeof(attributes);
 				HidD_GetAttributes(hDevice, &attributes);
-				if (attributes.VendorID == vid && attributes.ProductID == pid)
+				if (attributes.VendorID == vid && attributes.ProductID == pid && matched++ == which)
 					{
 					HidD_FlushQueue(hDevice);
 					if (read_fixed_block() != NULL)
@@ -191,17 +266,17 @@ delete fixed_block;
 		}
 	}
 #elif defined (__APPLE__)
-	uint8_t hid_report_number = 0;
-	void hid_init(IOHIDDeviceRef hDevice);
+	void callback(void *context, IOReturn result, void *sender, IOHIDReportType type, uint32_t reportID, uint8_t *report, CFIndex reportLength);
 	template <class T> T min(T a, T b) { return a < b ? a : b; }
 
 
 	/*
 		USB_WEATHER::CONNECT()
 		----------------------
+		Connect to the which'th (counting from 0) attached station with the given VID and PID.
 		Return an error code (or 0 for success)
 	*/
-	uint32_t usb_weather::connect(uint32_t vid, uint32_t pid)
+	uint32_t usb_weather::connect(uint32_t vid, uint32_t pid, uint32_t which)
 	{
 	IOHIDManagerRef hid_manager;
 	char string_buffer[1024];
@@ -213,7 +288,11 @@ delete fixed_block;
 	long vendor_id, product_id;
 	CFStringRef manufacturer, product_name;
 	int found = false;
+	uint32_t matched = 0;
 
+	this->vid = vid;
+	this->pid = pid;
+	this->which = which;
 	hDevice = INVALID_HANDLE_VALUE;
 
 	/*
@@ -269,7 +348,7 @@ delete fixed_block;
 			/*
 				See if this is the device we're looking for
 			*/
-			if (vendor_id == vid && product_id == pid)
+			if (vendor_id == vid && product_id == pid && matched++ == which)
 				{
 				found = true;
 				hDevice = *current;
@@ -287,7 +366,7 @@ delete fixed_block;
 		{
 		if (IOHIDDeviceOpen(hDevice, kIOHIDOptionsTypeSeizeDevice) == kIOReturnSuccess)
 			{
-			hid_init(hDevice);
+			IOHIDDeviceRegisterInputReportCallback(hDevice, mac_hid_buffer, sizeof(mac_hid_buffer), callback, &message_queue);
 			if (read_fixed_block() == NULL)
 				return 3;	// cannot read the fixed block.
 			}
@@ -302,7 +381,6 @@ delete fixed_block;
 		class MAC_HID_MESSAGE_OBJECT
 		----------------------------
 	*/
-	uint8_t mac_hid_buffer[1024 * 1024];
 	class mac_hid_message_object
 	{
 	public:
@@ -312,11 +390,11 @@ delete fixed_block;
 		uint8_t *report;
 		CFIndex reportLength;
 	} ;
-	std::queue<mac_hid_message_object *> message_queue;
 
 	/*
 		CALLBACK()
 		----------
+		A report has arrived from the device, context is the message queue of the usb_weather it is for
 	*/
 	void callback(void *context, IOReturn result, void *sender, IOHIDReportType type, uint32_t reportID, uint8_t *report, CFIndex reportLength)
 	{
@@ -330,23 +408,14 @@ delete fixed_block;
 	object->report = new uint8_t [reportLength];
 	memcpy(object->report, report, reportLength);
 
-	message_queue.push(object);
-	}
-
-	/*
-		HID_INIT()
-		----------
-	*/
-	void hid_init(IOHIDDeviceRef hDevice)
-	{
-	IOHIDDeviceRegisterInputReportCallback(hDevice, mac_hid_buffer, sizeof(mac_hid_buffer), callback, NULL);
+	((std::queue<mac_hid_message_object *> *)context)->push(object);
 	}
 
 	/*
-		READFILE()
-		----------
+		USB_WEATHER::READFILE()
+		-----------------------
 	*/
-	long ReadFile(HANDLE hDevice, void *recieve_buffer, DWORD to_read, DWORD *did_read, void *ignore)
+	long usb_weather::ReadFile(HANDLE hDevice, void *recieve_buffer, DWORD to_read, DWORD *did_read, void *ignore)
 	{
 	uint8_t *into = (uint8_t *)recieve_buffer;
 	
@@ -372,10 +441,10 @@ delete fixed_block;
 	}
 
 	/*
-		HIDD_SETOUTPUTREPORT()
-		----------------------
+		USB_WEATHER::HIDD_SETOUTPUTREPORT()
+		-----------------------------------
 	*/
-	long HidD_SetOutputReport(HANDLE hDevice, void *message, DWORD message_length)
+	long usb_weather::HidD_SetOutputReport(HANDLE hDevice, void *message, DWORD message_length)
 	{
 	IOReturn return_code;
 	
@@ -390,62 +459,277 @@ delete fixed_block;
 	return return_code == kIOReturnSuccess;
 	}
 
+	/*
+		USB_WEATHER::HIDD_FLUSHQUEUE()
+		------------------------------
+	*/
+	long usb_weather::HidD_FlushQueue(HANDLE hDevice)
+	{
+	mac_hid_message_object *object;
+
+	while (!message_queue.empty())
+		{
+		object = message_queue.front();
+		message_queue.pop();
+		delete [] object->report;
+		delete object;
+		}
+
+	return true;
+	}
+
 #else
 	/*
 		Linux versions of the USB methods
 	*/
 
-	uint8_t hid_report_number = 0;
+	/*
+		USB_WEATHER::IS_STATION()
+		-------------------------
+		Is the given hidraw device (e.g. "hidraw0") a station with the given VID and PID?  The answer comes from
+		sysfs so we don't need to open (or have permission to open) the device itself.
+	*/
+	long usb_weather::is_station(const char *device_name, uint32_t vid, uint32_t pid)
+	{
+	char filename[256], line[256];
+	unsigned int bus, device_vid, device_pid;
+	FILE *uevent;
+	long found = false;
+
+	snprintf(filename, sizeof(filename), "%s/%s/device/uevent", USB_WEATHER_SYSFS_HIDRAW, device_name);
+	if ((uevent = fopen(filename, "r")) == NULL)
+		return false;
 
 	/*
-		USB_WEATHER::CONNECT()
-		----------------------
+		We're looking for a line like "HID_ID=0003:00001941:00008021" (bus:vid:pid)
 	*/
-	uint32_t usb_weather::connect(uint32_t vid, uint32_t pid)
+	while (fgets(line, sizeof(line), uevent) != NULL)
+		if (sscanf(line, "HID_ID=%x:%x:%x", &bus, &device_vid, &device_pid) == 3)
+			{
+			found = (uint16_t)device_vid == (uint16_t)vid && (uint16_t)device_pid == (uint16_t)pid;
+			break;
+			}
+
+	fclose(uevent);
+
+	return found;
+	}
+
+	/*
+		USB_WEATHER::ENUMERATE()
+		------------------------
+		Find the numbers of the hidraw devices that are stations with the given VID and PID, in increasing order.
+		The hidraw devices are numbered in the order they were plugged in, and there can be gaps where one was
+		unplugged.  Returns the number found.
+	*/
+	long usb_weather::enumerate(uint32_t vid, uint32_t pid, long *ids, long max_ids)
+	{
+	DIR *directory;
+	struct dirent *entry;
+	long id, found = 0, current;
+
+	if ((directory = opendir(USB_WEATHER_SYSFS_HIDRAW)) == NULL)
+		return 0;
+
+	while (found < max_ids && (entry = readdir(directory)) != NULL)
+		if (sscanf(entry->d_name, "hidraw%ld", &id) == 1 && is_station(entry->d_name, vid, pid))
+			{
+			/*
+				Insert it in order (there are only ever a handful)
+			*/
+			for (current = found++; current > 0 && ids[current - 1] > id; current--)
+				ids[current] = ids[current - 1];
+			ids[current] = id;
+			}
+
+	closedir(directory);
+
+	return found;
+	}
+
+	/*
+		USB_WEATHER::DISCOVERY_LOOKUP()
+		-------------------------------
+		Where did we last find the given station?  Returns true (and the device's path) if we know
+	*/
+	long usb_weather::discovery_lookup(uint32_t vid, uint32_t pid, uint32_t which, char *path, size_t length)
+	{
+	char line[256], device[64];
+	unsigned int line_vid, line_pid, line_which;
+	FILE *file;
+	long found = false;
+
+	if ((file = fopen(USB_WEATHER_DISCOVERY_FILE, "r")) == NULL)
+		return false;
+
+	while (fgets(line, sizeof(line), file) != NULL)
+		if (sscanf(line, "%x %x %u %63s", &line_vid, &line_pid, &line_which, device) == 4 && line_vid == vid && line_pid == pid && line_which == which)
+			{
+			snprintf(path, length, "%s", device);
+			found = true;
+			break;
+			}
+
+	fclose(file);
+
+	return found;
+	}
+
+	/*
+		USB_WEATHER::DISCOVERY_STORE()
+		------------------------------
+		Remember where we found the given station (a line per station, re-written by way of a temporary file so
+		that a reader never sees half a file)
+	*/
+	void usb_weather::discovery_store(uint32_t vid, uint32_t pid, uint32_t which, const char *path)
+	{
+	char line[256], temporary[256];
+	unsigned int line_vid, line_pid, line_which;
+	FILE *from, *to;
+
+	snprintf(temporary, sizeof(temporary), "%s.%u.%ld", USB_WEATHER_DISCOVERY_FILE, which, (long)getpid());
+	if ((to = fopen(temporary, "w")) == NULL)
+		return;		// we'll just have to look for it next time
+
+	fprintf(to, "%04x %04x %u %s\n", vid, pid, which, path);
+	if ((from = fopen(USB_WEATHER_DISCOVERY_FILE, "r")) != NULL)
+		{
+		while (fgets(line, sizeof(line), from) != NULL)
+			if (sscanf(line, "%x %x %u", &line_vid, &line_pid, &line_which) == 3 && !(line_vid == vid && line_pid == pid && line_which == which))
+				fputs(line, to);
+		fclose(from);
+		}
+
+	if (fclose(to) != 0 || rename(temporary, USB_WEATHER_DISCOVERY_FILE) != 0)
+		unlink(temporary);
+	}
+
+	/*
+		USB_WEATHER::OPEN_DEVICE()
+		--------------------------
+		Open (and lock) the device at path and read its fixed block.  Return an error code (or 0 for success), as for connect()
+	*/
+	uint32_t usb_weather::open_device(const char *path)
 	{
-	char message_buffer[32];
-	struct hidraw_devinfo device;
-	long id;
 	int file, got;
 
-	hDevice = INVALID_HANDLE_VALUE;
-	for (id = 0; id < 1024; id++)
+	if ((file = open(path, O_RDWR | O_NONBLOCK)) == -1)
+		return errno == ENOENT ? 2 : 1;		// it's gone (2) or we can't use it (1)
+
+	do
 		{
-		sprintf(message_buffer, "/dev/hidraw%ld", id);
-		if ((file = open(message_buffer, O_RDWR)) == -1)
-			return 1;		// can't connect to the weather station
-		else 
+		if ((got = flock(file, LOCK_EX | LOCK_NB)) != 0)
 			{
-			do
-				{
-				if ((got = flock(file, LOCK_EX | LOCK_NB)) != 0)
-					{
-					if (errno == EWOULDBLOCK)
-						return 4;			// would block (another process is using the device)
-					}
-				}
-			while (got != 0);
-			if (ioctl(file, HIDIOCGRAWINFO, &device) >= 0 && (uint16_t)device.vendor == (uint16_t)vid && (uint16_t)device.product == (uint16_t)pid)
+			if (errno == EWOULDBLOCK)
 				{
-				hDevice = file;
-				if (read_fixed_block() == NULL)
-					return 3;	// cannot read the fixed block.
-				return 0;
+				close(file);
+				return 4;			// would block (another process is using the device)
 				}
-			flock(file, LOCK_UN);
-			close(file);
 			}
 		}
-	return 2;				// Can't find an attached weather station
+	while (got != 0);
+
+	hDevice = file;
+	snprintf(device_path, sizeof(device_path), "%s", path);
+	if (read_fixed_block() == NULL)
+		return 3;	// cannot read the fixed block.
+
+	return 0;
 	}
 
 	/*
-		READFILE()
-		----------
+		USB_WEATHER::CONNECT()
+		----------------------
+		Connect to the which'th (counting from 0) attached station with the given VID and PID.  Try the device we
+		found it on last time first (which is one open if it's still there), otherwise look the stations up in
+		sysfs (without opening anything) and open the one we want.
 	*/
-	long ReadFile(HANDLE hDevice, void *buffer, DWORD bytes_to_read, DWORD *bytes_read, void *ignore)
+	uint32_t usb_weather::connect(uint32_t vid, uint32_t pid, uint32_t which)
+	{
+	long ids[MAX_DEVICES];
+	char path[64];
+	uint32_t error;
+
+	this->vid = vid;
+	this->pid = pid;
+	this->which = which;
+	hDevice = INVALID_HANDLE_VALUE;
+
+	if (discovery_lookup(vid, pid, which, path, sizeof(path)) && strncmp(path, USB_WEATHER_DEV "/", strlen(USB_WEATHER_DEV "/")) == 0 && is_station(path + strlen(USB_WEATHER_DEV "/"), vid, pid))
+		if ((error = open_device(path)) == 0 || error == 3)
+			return error;
+
+	if (enumerate(vid, pid, ids, MAX_DEVICES) <= (long)which)
+		return 2;				// Can't find an attached weather station
+
+	snprintf(path, sizeof(path), "%s/hidraw%ld", USB_WEATHER_DEV, ids[which]);
+	if ((error = open_device(path)) == 0)
+		discovery_store(vid, pid, which, path);
+
+	return error;
+	}
+
+	/*
+		USB_WEATHER::WAIT_FOR()
+		-----------------------
+		Wait until the device is ready for reading (POLLIN) or writing (POLLOUT), or the deadline passes.
+		Returns true if ready, false on timeout (errno == ETIMEDOUT) or error.
+	*/
+	long usb_weather::wait_for(HANDLE hDevice, short events, const struct timespec *deadline)
+	{
+	struct pollfd request;
+	struct timespec now;
+	long long remaining;
+	int got;
+
+	request.fd = hDevice;
+	request.events = events;
+	do
+		{
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		remaining = (deadline->tv_sec - now.tv_sec) * 1000LL + (deadline->tv_nsec - now.tv_nsec) / 1000000;
+		if (remaining <= 0)
+			{
+			errno = ETIMEDOUT;
+			return false;
+			}
+		}
+	while ((got = poll(&request, 1, (int)remaining)) < 0 && errno == EINTR);
+
+	if (got == 0)
+		{
+		errno = ETIMEDOUT;
+		return false;
+		}
+
+	return got > 0 && (request.revents & events) != 0;
+	}
+
+	/*
+		USB_WEATHER::DEADLINE()
+		-----------------------
+		When the current transaction must be finished by
+	*/
+	void usb_weather::deadline(struct timespec *when)
+	{
+	clock_gettime(CLOCK_MONOTONIC, when);
+	when->tv_sec += timeout_in_ms / 1000;
+	if ((when->tv_nsec += (timeout_in_ms % 1000) * 1000000L) >= 1000000000L)
+		{
+		when->tv_sec++;
+		when->tv_nsec -= 1000000000L;
+		}
+	}
+
+	/*
+		USB_WEATHER::READFILE()
+		-----------------------
+		The device is opened non-blocking so that a station that stops answering can't hang us
+	*/
+	long usb_weather::ReadFile(HANDLE hDevice, void *buffer, DWORD bytes_to_read, DWORD *bytes_read, void *ignore)
 	{
 	DWORD remaining, got;
+	struct timespec when;
 	uint8_t *into;
 
 	into = (uint8_t *)buffer;
@@ -456,12 +740,15 @@ delete fixed_block;
 	*into++ = hid_report_number;
 	*bytes_read = 1;
 
+	deadline(&when);
 	remaining = bytes_to_read;
 	while (remaining > 0)
 		{
-		if ((got = read(hDevice, into, remaining)) < 0)
+		if ((got = ::read(hDevice, into, remaining)) < 0)
 			{
-			*bytes_read += bytes_to_read;
+			if ((errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) && wait_for(hDevice, POLLIN, &when))
+				continue;
+			*bytes_read += bytes_to_read - remaining;
 			return false;
 			}
 
@@ -474,29 +761,52 @@ delete fixed_block;
 	}
 
 	/*
-		HIDD_SETOUTPUTREPORT()
-		----------------------
+		USB_WEATHER::HIDD_SETOUTPUTREPORT()
+		-----------------------------------
 	*/
-	long HidD_SetOutputReport(HANDLE hDevice, void *message, DWORD message_length)
+	long usb_weather::HidD_SetOutputReport(HANDLE hDevice, void *message, DWORD message_length)
 	{
+	struct timespec when;
+	ssize_t got;
+
 	hid_report_number = *(uint8_t *)message;
-	return write(hDevice, message, message_length) == message_length;
+
+	deadline(&when);
+	while ((got = write(hDevice, message, message_length)) < 0)
+		if ((errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) || !wait_for(hDevice, POLLOUT, &when))
+			return false;
+
+	return got == message_length;
+	}
+
+	/*
+		USB_WEATHER::HIDD_FLUSHQUEUE()
+		------------------------------
+		Throw away anything waiting to be read (such as the late reply to a request that timed out)
+	*/
+	long usb_weather::HidD_FlushQueue(HANDLE hDevice)
+	{
+	uint8_t buffer[64];
+
+	while (::read(hDevice, buffer, sizeof(buffer)) > 0)
+		;	// nothing
+
+	return true;
 	}
 
 #endif
 
 /*
-	USB_WEATHER::READ()
-	-------------------
+	USB_WEATHER::REQUEST()
+	----------------------
+	Ask the station for the 32 bytes at address, but don't wait for the answer (call receive() for that).
+	Returns false on failure.
 */
-uint32_t usb_weather::read(uint16_t address, void *result)
+long usb_weather::request(uint16_t address)
 {
-uint32_t bytes = 32;
-unsigned char recieve_buffer[64];
-uint8_t *into = (uint8_t *)result;
 usb_weather_message message;
-DWORD dwBytes = 0, dwBytesToRead;
-long long remaining;
+uint64_t start;
+long sent;
 
 message.zero = 0;
 message.report_id = message.aux_report_id = 0xa1;
@@ -504,69 +814,270 @@ message.address_high = message.aux_address_high = (address >> 8) & 0xFF;
 message.address_low = message.aux_address_low = address & 0xFF; 
 message.end_of_message = message.aux_end_of_message = 0x20;
 
+/*
+	If the last request failed then its reply might still turn up, so throw it away
+*/
+if (flush_before_next)
+	{
+	HidD_FlushQueue(hDevice);
+	flush_before_next = false;
+	}
+
 /*
 	Transmit the read request to the weather station
 */
-if (HidD_SetOutputReport(hDevice, &message, sizeof(message)))
+start = usb_weather_statistics::now_in_us();
+sent = HidD_SetOutputReport(hDevice, &message, sizeof(message));
+statistics.write.add(usb_weather_statistics::now_in_us() - start);
+statistics.usb_writes++;
+
+if (sent)
+	{
+	statistics.bytes_sent += sizeof(message);
+	return true;
+	}
+
+flush_before_next = true;
+return false;		// failure
+}
+
+/*
+	USB_WEATHER::RECEIVE()
+	----------------------
+	Wait for the answer to the last request().  Returns the number of bytes recieved (32) or 0 on failure.
+*/
+uint32_t usb_weather::receive(void *result)
+{
+uint32_t bytes = 32;
+unsigned char recieve_buffer[64];
+uint8_t *into = (uint8_t *)result;
+DWORD dwBytes = 0, dwBytesToRead;
+long long remaining;
+uint64_t start;
+long got;
+
+remaining = bytes;
+while (remaining > 0)
+	{
+#ifdef _MSC_VER
+	dwBytesToRead = bytes;
+#else
+	dwBytesToRead = remaining;
+#endif
+	start = usb_weather_statistics::now_in_us();
+	got = ReadFile(hDevice, recieve_buffer, dwBytesToRead, &dwBytes, NULL);
+	statistics.read.add(usb_weather_statistics::now_in_us() - start);
+	statistics.usb_reads++;
+
+	if (!got)
+		{
+#ifndef _MSC_VER
+		if (errno == ETIMEDOUT)
+			statistics.timeouts++;
+#endif
+		flush_before_next = true;
+		return 0;		// timeout (or error)
+		}
+
+	dwBytes -= 1;	// skip over the report ID
+	statistics.bytes_received += dwBytes;
+	memcpy(into, recieve_buffer + 1, (size_t)dwBytes);
+	into += dwBytes;
+	remaining -= dwBytes;
+	}
+
+return bytes;		// success
+}
+
+/*
+	USB_WEATHER::READ()
+	-------------------
+*/
+uint32_t usb_weather::read(uint16_t address, void *result)
+{
+if (!request(address))
+	return 0;
+
+return receive(result);
+}
+
+/*
+	USB_WEATHER::READ_MANY()
+	------------------------
+	Read the 32 bytes at each of count addresses into into (which must be count * 32 bytes long).  Up to
+	pipeline_depth() requests are kept in flight; as soon as the answer to one is in we send the next, and only
+	then call callback (if there is one) with the block we've just got.  That way whatever the caller does with
+	each block happens while the next one is on the wire.  A block that fails is retried (without the overlap).
+	Returns the number of blocks read before the first that could not be read.
+*/
+uint32_t usb_weather::read_many(const uint16_t *addresses, uint32_t count, uint8_t *into, usb_weather_block_callback callback, void *context)
+{
+static const uint32_t MAX_DEPTH = 256;
+uint64_t sent[MAX_DEPTH];					// when each request in flight was sent
+uint32_t depth, current, requested, unwanted;
+uint8_t *block;
+
+depth = pipeline_depth() < MAX_DEPTH ? pipeline_depth() : MAX_DEPTH;
+requested = 0;
+for (current = 0; current < count; current++)
 	{
 	/*
-		Recieve the reply
+		Keep the pipe full
 	*/
-	remaining = bytes;
-	while (remaining > 0)
+	while (requested < count && requested < current + depth)
+		{
+		sent[requested % MAX_DEPTH] = usb_weather_statistics::now_in_us();
+		if (!request(addresses[requested]))
+			break;
+		requested++;
+		}
+
+	block = into + current * 32;
+	if (current >= requested || receive(block) == 0)
+		{
+		/*
+			Throw away the answers to anything else in flight (so that they don't get mixed up with the retry)
+		*/
+		for (unwanted = current + 1; unwanted < requested; unwanted++)
+			receive(block);
+		requested = current + 1;
+
+		statistics.retries++;
+		if (read_with_retry(addresses[current], block) == 0)
+			return current;
+		}
+	else
 		{
+		statistics.transactions++;
+		statistics.transaction.add(usb_weather_statistics::now_in_us() - sent[current % MAX_DEPTH]);
+		}
+
+	/*
+		Get the next request on its way before doing anything with this block
+	*/
+	while (requested < count && requested < current + 1 + depth)
+		{
+		sent[requested % MAX_DEPTH] = usb_weather_statistics::now_in_us();
+		if (!request(addresses[requested]))
+			break;
+		requested++;
+		}
+
+	if (callback != NULL)
+		callback(context, current, block);
+	}
+
+return count;
+}
+
+/*
+	USB_WEATHER::SET_TIMEOUT()
+	--------------------------
+	How long to wait for the station to answer before giving up (and retrying)
+*/
+void usb_weather::set_timeout(uint32_t milliseconds)
+{
+timeout_in_ms = milliseconds;
+
 #ifdef _MSC_VER
-		dwBytesToRead = bytes;
-#else
-		dwBytesToRead = remaining;
+	if (hDevice != INVALID_HANDLE_VALUE)
+		{
+		COMMTIMEOUTS timeout = {timeout_in_ms, 0, timeout_in_ms, 0, timeout_in_ms};
+
+		SetCommTimeouts(hDevice, &timeout);
+		}
 #endif
-		if (!ReadFile(hDevice, recieve_buffer, dwBytesToRead, &dwBytes, NULL))
-			return 0;
+}
 
-		dwBytes -= 1;	// skip over the report ID
-		memcpy(into, recieve_buffer + 1, (size_t)dwBytes);
-		into += dwBytes;
-		remaining -= dwBytes;
+/*
+	USB_WEATHER::READ_WITH_RETRY()
+	------------------------------
+	The station occasionally fails to answer, so try a few times before giving up
+*/
+uint32_t usb_weather::read_with_retry(uint16_t address, void *result)
+{
+uint32_t got;
+long trial;
+uint64_t start;
+static const long MAX_TRIALS = 3;			// maximum number of attempts to read before timeout
+
+statistics.transactions++;
+start = usb_weather_statistics::now_in_us();
+for (trial = 0; trial < MAX_TRIALS; trial++)
+	{
+	if (trial != 0)
+		statistics.retries++;
+	if ((got = read(address, result)) != 0)
+		{
+		statistics.transaction.add(usb_weather_statistics::now_in_us() - start);
+		return got;
 		}
-	return bytes;		// success
 	}
 
-return 0;		// failure
+statistics.failures++;
+return 0;									// failed to read from device so timeout
+}
+
+/*
+	USB_WEATHER::DECODE_READING()
+	-----------------------------
+	Convert a reading from the station into human usable units (the part of a reading common to all models)
+*/
+void usb_weather::decode_reading(usb_weather_reading *answer, const usb_weather_reading_raw *buffer)
+{
+answer->delay = buffer->delay;
+answer->indoor_humidity = buffer->indoor_humidity;
+answer->indoor_temperature = decode_temperature(buffer->indoor_temperature) / 10.0;
+answer->outdoor_humidity = buffer->outdoor_humidity;
+answer->outdoor_temperature = decode_temperature(buffer->outdoor_temperature) / 10.0;
+answer->absolute_pressure = decode(buffer->absolute_pressure) / 10.0;
+answer->average_windspeed = (buffer->average_windspeed_low | ((buffer->windspeed_high & 0x0F) << 8)) / 10.0;
+answer->gust_windspeed = (buffer->gust_windspeed_low | (((buffer->windspeed_high >> 4) & 0x0F) << 8)) / 10.0;
+answer->wind_direction = buffer->wind_direction * 22.5;
+answer->total_rain = decode(buffer->total_rain) * 0.3;
+answer->rain_counter_overflow = buffer->status & 0x80 ? true : false;
+answer->lost_communications = buffer->status & 0x40 ? true : false;
+answer->light = 0;
+answer->uv = 0;
+answer->has_solar = false;
+}
+
+/*
+	USB_WEATHER::DECODE_RECORD()
+	----------------------------
+	Convert a reading from a station of the given model into human usable units
+*/
+template <class MODEL>
+void usb_weather::decode_record(usb_weather_reading *answer, const uint8_t *raw)
+{
+decode_reading(answer, (const usb_weather_reading_raw *)raw);
+
+if (MODEL::HAS_SOLAR)
+	{
+	answer->light = (raw[16] | (raw[17] << 8) | (raw[18] << 16)) / 10.0;
+	answer->uv = raw[19];
+	answer->has_solar = true;
+	}
 }
 
 /*
 	USB_WEATHER::READ_READING()
 	---------------------------
 */
+template <class MODEL>
 usb_weather_reading *usb_weather::read_reading(uint16_t address)
 {
 usb_weather_reading *answer;
-usb_weather_reading_raw buffer;
-long trial;
-static const long MAX_TRIALS = 3;			// maximum number of attempts to read before timeout
+uint8_t buffer[32];
 
-trial = 0;
-while ((read(address, (uint8_t*)&buffer) == 0) && (trial < MAX_TRIALS))
-	trial++;
-if (trial == MAX_TRIALS)
+if (read_with_retry(address, buffer) == 0)
 	return NULL;							// failed to read from device so timeout
 
 /*
 	Convert it into human usable units
 */
 answer = new usb_weather_reading;
-answer->delay = buffer.delay;
-answer->indoor_humidity = buffer.indoor_humidity;
-answer->indoor_temperature = decode_temperature(buffer.indoor_temperature) / 10.0;
-answer->outdoor_humidity = buffer.outdoor_humidity;
-answer->outdoor_temperature = decode_temperature(buffer.outdoor_temperature) / 10.0;
-answer->absolute_pressure = decode(buffer.absolute_pressure) / 10.0;
-answer->average_windspeed = (buffer.average_windspeed_low | (buffer.windspeed_high & 0x0F)) / 10.0;
-answer->gust_windspeed = (buffer.gust_windspeed_low | ((buffer.windspeed_high >> 4) & 0x0F)) / 10.0;
-answer->wind_direction = buffer.wind_direction * 22.5;
-answer->total_rain = decode(buffer.total_rain) * 0.3;
-answer->rain_counter_overflow = buffer.status & 0x80 ? true : false;
-answer->lost_communications = buffer.status & 0x40 ? true : false;
+decode_record<MODEL>(answer, buffer);
 
 /*
 	Pass it back to the caller
@@ -574,14 +1085,271 @@ answer->lost_communications = buffer.status & 0x40 ? true : false;
 return answer;
 }
 
+/*
+	USB_WEATHER::READ_READING()
+	---------------------------
+*/
+usb_weather_reading *usb_weather::read_reading(uint16_t address)
+{
+return model == usb_weather_model_3080::MODEL ? read_reading<usb_weather_model_3080>(address) : read_reading<usb_weather_model_1080>(address);
+}
+
+/*
+	USB_WEATHER::READING_ADDRESSES()
+	--------------------------------
+	Fill addresses with the addresses to read() in order to get the readings from first up to (but not including)
+	last, and records with the number of readings that each read gets us.  Each read from the station returns 32
+	bytes, which is two WH1080 readings (but only one WH3080 reading), and a read never goes past the end of the
+	ring.  Returns the number of addresses (at most last - first).
+*/
+template <class MODEL>
+uint32_t usb_weather::reading_addresses(usb_weather_ring_iterator<MODEL> first, usb_weather_ring_iterator<MODEL> last, uint16_t *addresses, uint8_t *records)
+{
+uint32_t blocks;
+uint16_t previous;
+
+blocks = 0;
+while (first < last)
+	{
+	addresses[blocks] = *first;
+	records[blocks] = 0;
+	do
+		{
+		records[blocks]++;
+		previous = *first++;
+		}
+	while (first < last && records[blocks] < 32 / MODEL::RECORD_SIZE && *first > previous);
+	blocks++;
+	}
+
+return blocks;
+}
+
+/*
+	USB_WEATHER::READ_RAW_READINGS()
+	--------------------------------
+	Read the readings from first up to (but not including) last into into (which must be (last - first) *
+	MODEL::RECORD_SIZE bytes long).  Returns the number of readings read (which is less than last - first on error).
+*/
+template <class MODEL>
+uint32_t usb_weather::read_raw_readings(usb_weather_ring_iterator<MODEL> first, usb_weather_ring_iterator<MODEL> last, uint8_t *into)
+{
+uint16_t *addresses;
+uint8_t *records, *buffer;
+uint32_t blocks, got, current, count;
+
+count = last - first;
+addresses = new uint16_t [count];
+records = new uint8_t [count];
+blocks = reading_addresses<MODEL>(first, last, addresses, records);
+
+buffer = new uint8_t [blocks * 32];
+got = read_many(addresses, blocks, buffer);
+
+/*
+	Squeeze out the parts of each block we don't want
+*/
+count = 0;
+for (current = 0; current < got; current++)
+	{
+	memcpy(into, buffer + current * 32, records[current] * MODEL::RECORD_SIZE);
+	into += records[current] * MODEL::RECORD_SIZE;
+	count += records[current];
+	}
+
+delete [] buffer;
+delete [] records;
+delete [] addresses;
+
+return count;
+}
+
+/*
+	USB_WEATHER::READ_RAW_READINGS()
+	--------------------------------
+	Read count consecutive readings starting at address (wrapping from the end of the ring back to the start) into
+	into (which must be count * get_record_size() bytes long).  Returns the number of readings read.
+*/
+uint32_t usb_weather::read_raw_readings(uint16_t address, uint32_t count, uint8_t *into)
+{
+if (model == usb_weather_model_3080::MODEL)
+	return read_raw_readings(usb_weather_ring_iterator<usb_weather_model_3080>(address), usb_weather_ring_iterator<usb_weather_model_3080>(address, count), into);
+else
+	return read_raw_readings(usb_weather_ring_iterator<usb_weather_model_1080>(address), usb_weather_ring_iterator<usb_weather_model_1080>(address, count), into);
+}
+
+/*
+	USB_WEATHER::READ_COMPACT_READINGS()
+	------------------------------------
+	Read count consecutive readings starting at address into into (which must be count long).
+	Returns the number of readings read (which is less than count on error).
+*/
+template <class MODEL>
+uint32_t usb_weather::read_compact_readings(uint16_t address, uint32_t count, usb_weather_reading_compact *into)
+{
+uint8_t *raw;
+uint32_t got, current;
+
+raw = new uint8_t [count * MODEL::RECORD_SIZE];
+got = read_raw_readings(usb_weather_ring_iterator<MODEL>(address), usb_weather_ring_iterator<MODEL>(address, count), raw);
+for (current = 0; current < got; current++)
+	into[current].decode(raw + current * MODEL::RECORD_SIZE);
+delete [] raw;
+
+return got;
+}
+
+/*
+	USB_WEATHER::READ_COMPACT_READINGS()
+	------------------------------------
+*/
+uint32_t usb_weather::read_compact_readings(uint16_t address, uint32_t count, usb_weather_reading_compact *into)
+{
+return model == usb_weather_model_3080::MODEL ? read_compact_readings<usb_weather_model_3080>(address, count, into) : read_compact_readings<usb_weather_model_1080>(address, count, into);
+}
+
+/*
+	class USB_WEATHER_DECODER
+	-------------------------
+	What decode_block() needs to know to decode each block as it arrives
+*/
+class usb_weather_decoder
+{
+public:
+	usb_weather_reading **readings;
+	const uint8_t *records;					// number of readings in each block
+	const uint32_t *first;					// index into readings of the first reading in each block
+} ;
+
+/*
+	USB_WEATHER::DECODE_BLOCK()
+	---------------------------
+	read_many() callback that decodes the readings in a block while the next block is on its way
+*/
+template <class MODEL>
+void usb_weather::decode_block(void *context, uint32_t which, const uint8_t *block)
+{
+usb_weather_decoder *decoder = (usb_weather_decoder *)context;
+usb_weather_reading **into = decoder->readings + decoder->first[which];
+uint32_t current;
+
+for (current = 0; current < decoder->records[which]; current++)
+	{
+	into[current] = new usb_weather_reading;
+	decode_record<MODEL>(into[current], block + current * MODEL::RECORD_SIZE);
+	}
+}
+
+/*
+	USB_WEATHER::READ_READINGS()
+	----------------------------
+	Read the readings from first up to (but not including) last.  Readings that cannot be read are returned as NULL.
+*/
+template <class MODEL>
+usb_weather_reading **usb_weather::read_readings(usb_weather_ring_iterator<MODEL> from, usb_weather_ring_iterator<MODEL> to)
+{
+usb_weather_reading **readings;
+usb_weather_decoder decoder;
+uint16_t *addresses;
+uint8_t *records, *buffer;
+uint32_t *first, blocks, current, count;
+
+count = to - from;
+readings = new usb_weather_reading *[count];
+for (current = 0; current < count; current++)
+	readings[current] = NULL;
+
+addresses = new uint16_t [count];
+records = new uint8_t [count];
+first = new uint32_t [count];
+blocks = reading_addresses<MODEL>(from, to, addresses, records);
+for (current = 0; current < blocks; current++)
+	first[current] = current == 0 ? 0 : first[current - 1] + records[current - 1];
+
+decoder.readings = readings;
+decoder.records = records;
+decoder.first = first;
+
+buffer = new uint8_t [blocks * 32];
+read_many(addresses, blocks, buffer, decode_block<MODEL>, &decoder);
+
+delete [] buffer;
+delete [] first;
+delete [] records;
+delete [] addresses;
+
+return readings;
+}
+
+/*
+	USB_WEATHER::READ_READINGS()
+	----------------------------
+	Read count consecutive readings starting at address (wrapping from the end of the ring back to the start)
+*/
+usb_weather_reading **usb_weather::read_readings(uint16_t address, uint32_t count)
+{
+if (model == usb_weather_model_3080::MODEL)
+	return read_readings(usb_weather_ring_iterator<usb_weather_model_3080>(address), usb_weather_ring_iterator<usb_weather_model_3080>(address, count));
+else
+	return read_readings(usb_weather_ring_iterator<usb_weather_model_1080>(address), usb_weather_ring_iterator<usb_weather_model_1080>(address, count));
+}
+
+/*
+	USB_WEATHER::READ_HISTORY()
+	---------------------------
+	Read the most recent max_readings readings (or as many as there are if max_readings < 0) into history, oldest
+	first.  The raw records are read first and then decoded all at once.  Returns the number of readings read
+	(history->readings), which is 0 if we cannot talk to the station.
+*/
+template <class MODEL>
+uint32_t usb_weather::read_history(usb_weather_history *history, int32_t max_readings)
+{
+uint32_t wanted, got;
+uint8_t *raw;
+
+if (fixed_block == NULL)
+	{
+	history->resize(0);
+	return 0;
+	}
+
+if (max_readings < 0 || (uint32_t)max_readings > fixed_block->data_count)
+	wanted = fixed_block->data_count;
+else
+	wanted = max_readings;
+
+if (wanted == 0)
+	{
+	history->resize(0);
+	return 0;
+	}
+
+raw = new uint8_t [wanted * MODEL::RECORD_SIZE];
+got = read_raw_readings(usb_weather_ring<MODEL>::begin(fixed_block->current_position, wanted), usb_weather_ring<MODEL>::end(fixed_block->current_position), raw);
+history->resize(got);
+history->decode<MODEL>(0, raw, got);
+delete [] raw;
+
+return got;
+}
+
+/*
+	USB_WEATHER::READ_HISTORY()
+	---------------------------
+*/
+uint32_t usb_weather::read_history(usb_weather_history *history, int32_t max_readings)
+{
+return model == usb_weather_model_3080::MODEL ? read_history<usb_weather_model_3080>(history, max_readings) : read_history<usb_weather_model_1080>(history, max_readings);
+}
+
 /*
 	USB_WEATHER::READ_FIXED_BLOCK()
 	-------------------------------
 */
 usb_weather_fixed_block_1080 *usb_weather::read_fixed_block(void)
 {
-uint8_t *into;
-uint16_t address = 0;
+uint16_t addresses[sizeof(usb_weather_fixed_block_1080) / 32];
+uint32_t block;
 
 /*
 	If we've already read it then don't read it again
@@ -597,18 +1365,84 @@ fixed_block = new usb_weather_fixed_block_1080;
 /*
 	Read into it... in 32-byte chunks
 */
-into = (uint8_t *)fixed_block;
-while (address < sizeof(*fixed_block))
+for (block = 0; block < sizeof(*fixed_block) / 32; block++)
+	addresses[block] = block * 32;
+
+if (read_many(addresses, sizeof(*fixed_block) / 32, (uint8_t *)fixed_block) != sizeof(*fixed_block) / 32)
 	{
-	if (read(address, into) == 0)
-		return NULL;
-	into += sizeof(usb_weather_reading_raw);
-	address += sizeof(usb_weather_reading_raw);
+	delete fixed_block;
+	return fixed_block = NULL;
 	}
 
 return fixed_block;
 }
 
+/*
+	USB_WEATHER::RELOAD_FIXED_BLOCK()
+	---------------------------------
+	Throw away the fixed block we have and read it again from the station (the current time, the
+	current position, and the number of readings all change while the station is running)
+*/
+usb_weather_fixed_block_1080 *usb_weather::reload_fixed_block(void)
+{
+delete fixed_block;
+fixed_block = NULL;
+
+return read_fixed_block();
+}
+
+/*
+	USB_WEATHER::PROBE_FIXED_BLOCK()
+	--------------------------------
+	Has the station stored a new reading (or been reset) since we last read the fixed block?  data_count and
+	current_position are both in the first 32 bytes so this costs one transaction rather than the eight of
+	reload_fixed_block().  Those 32 bytes are copied into the fixed block we have (the rest of it is left as it
+	was).  Returns 1 if either has changed (or we had no fixed block), 0 if not, and -1 on error.
+*/
+long usb_weather::probe_fixed_block(void)
+{
+uint8_t chunk[32];
+size_t count_at, position_at;
+long changed;
+
+if (fixed_block == NULL)
+	return read_fixed_block() == NULL ? -1 : 1;
+
+if (read_with_retry(0, chunk) != sizeof(chunk))
+	return -1;
+
+count_at = offsetof(usb_weather_fixed_block_1080, data_count);
+position_at = offsetof(usb_weather_fixed_block_1080, current_position);
+changed = memcmp((uint8_t *)fixed_block + count_at, chunk + count_at, sizeof(fixed_block->data_count)) != 0 || memcmp((uint8_t *)fixed_block + position_at, chunk + position_at, sizeof(fixed_block->current_position)) != 0;
+
+memcpy(fixed_block, chunk, sizeof(chunk));
+
+return changed;
+}
+
+/*
+	USB_WEATHER::HISTORY_ADDRESS()
+	------------------------------
+	Return the address of the reading taken readings_ago readings before the current one
+*/
+uint16_t usb_weather::history_address(uint32_t readings_ago)
+{
+if (fixed_block == NULL)
+	return usb_weather_model_1080::FIRST_RECORD;
+
+return model == usb_weather_model_3080::MODEL ? usb_weather_ring<usb_weather_model_3080>::ago(fixed_block->current_position, readings_ago) : usb_weather_ring<usb_weather_model_1080>::ago(fixed_block->current_position, readings_ago);
+}
+
+/*
+	USB_WEATHER::READINGS_BETWEEN()
+	-------------------------------
+	The number of readings from the one at from forward (around the ring) to the one at to
+*/
+uint32_t usb_weather::readings_between(uint16_t from, uint16_t to)
+{
+return model == usb_weather_model_3080::MODEL ? usb_weather_ring<usb_weather_model_3080>::distance(from, to) : usb_weather_ring<usb_weather_model_1080>::distance(from, to);
+}
+
 /*
 	USB_WEATHER::READ_ALL_READINGS()
 	--------------------------------
@@ -617,8 +1451,6 @@ return fixed_block;
 usb_weather_reading **usb_weather::read_all_readings(uint32_t *readings, int32_t max_readings)
 {
 usb_weather_reading **history;
-uint16_t address;
-uint32_t current;
 
 /*
 	Do we have communications?
@@ -638,24 +1470,9 @@ else
 	max_readings = fixed_block->data_count < max_readings ? fixed_block->data_count : max_readings;
 
 /*
-	Get the base address of the first reading
-*/
-address = 0x100 + ((fixed_block->current_position - 0x100) - ((max_readings - 1) * 16));
-
-/*
-	Allocate space
-*/
-history = new usb_weather_reading *[max_readings];
-
-/*
-	Download each reading
+	Download the readings, oldest first
 */
-for (current = 0; current < max_readings; current++)
-	{
-	history[current] = read_reading(address);
-	if ((address += 16)  < 0x100)
-		address = 0x100;			// wrap around to 0x100
-	}
+history = read_readings(history_address(max_readings - 1), max_readings);
 
 /*
 	Pass the results back to the caller
@@ -688,8 +1505,6 @@ return read_reading(fixed_block->current_position);
 */
 usb_weather_reading *usb_weather::read_previous_readings(void)
 {
-uint16_t address;
-
 /*
 	Make sure we have the address we need
 */
@@ -702,10 +1517,7 @@ if (fixed_block->data_count <= 1)
 /*
 	Get the reading
 */
-if ((address = fixed_block->current_position - 16) < 0x100)
-	address = 0x10000 - sizeof(usb_weather_reading_raw);
-
-return read_reading(address);
+return read_reading(history_address(1));
 }
 
 /*
@@ -716,9 +1528,11 @@ return read_reading(address);
 	data, we're a bit stuck.  So we'll return an object that contains the correct data for the shortest time
 	greater than 59 minutes.  To linearly interpolate that data (to one hour) call interpolate_hourly_data()
 */
+template <class MODEL>
 usb_weather_reading *usb_weather::read_hourly_delta(void)
 {
-uint16_t max_reads, time, address;
+std::reverse_iterator<usb_weather_ring_iterator<MODEL> > address;
+uint16_t max_reads, time;
 usb_weather_reading *now, *previous;
 uint8_t rain_overflow, finish;
 
@@ -728,9 +1542,9 @@ uint8_t rain_overflow, finish;
 if (fixed_block == NULL)
 	return NULL;
 
-address = fixed_block->current_position;
+address = std::reverse_iterator<usb_weather_ring_iterator<MODEL> >(usb_weather_ring<MODEL>::end(fixed_block->current_position));
 max_reads = fixed_block->data_count;
-if ((previous = now = read_reading(address)) == NULL)
+if ((previous = now = read_reading<MODEL>(*address)) == NULL)
 	return NULL;
 
 rain_overflow = now->rain_counter_overflow;
@@ -739,9 +1553,7 @@ max_reads--;
 finish = max_reads <= 0;
 while (!finish)
 	{
-	if ((address -= 16) < 0x100)
-		address = 0x10000 - sizeof(usb_weather_reading_raw);
-	if ((previous = read_reading(address)) == NULL)
+	if ((previous = read_reading<MODEL>(*++address)) == NULL)
 		{
 		delete now;
 		return NULL;
@@ -773,6 +1585,15 @@ now->lost_communications = max_reads < 0;					// not lost_communications, more "
 return now;
 }
 
+/*
+	USB_WEATHER::READ_HOURLY_DELTA()
+	--------------------------------
+*/
+usb_weather_reading *usb_weather::read_hourly_delta(void)
+{
+return model == usb_weather_model_3080::MODEL ? read_hourly_delta<usb_weather_model_3080>() : read_hourly_delta<usb_weather_model_1080>();
+}
+
 /*
 	USB_WEATHER::INTERPOLATE_HOURLY_DELTA()
 	---------------------------------------
@@ -795,6 +1616,9 @@ hourly_delta->wind_direction = delta->wind_direction;
 hourly_delta->total_rain = (delta->total_rain / delta->delay) * 60;
 hourly_delta->rain_counter_overflow = delta->rain_counter_overflow;
 hourly_delta->lost_communications = delta->lost_communications;
+hourly_delta->light = delta->light;
+hourly_delta->uv = delta->uv;
+hourly_delta->has_solar = delta->has_solar;
 
 return hourly_delta;
 }
@@ -803,14 +1627,21 @@ return hourly_delta;
 	USB_WEATHER::READ_HIGHS_AND_LOWS()
 	----------------------------------
 */
+template <class MODEL>
 usb_weather_reading *usb_weather::read_highs_and_lows(usb_weather_reading *highs, usb_weather_reading *lows, uint32_t since_minutes_ago)
 {
-uint16_t max_reads, time, address;
+std::reverse_iterator<usb_weather_ring_iterator<MODEL> > address;
+uint16_t max_reads, time;
 usb_weather_reading *reading;
 uint8_t rain_overflow, lost_communications, finish;
 
 lows->indoor_humidity = lows->outdoor_humidity = lows->indoor_temperature = lows->outdoor_temperature = lows->absolute_pressure = lows->average_windspeed = lows->gust_windspeed = lows->total_rain = DBL_MAX;
 highs->indoor_humidity = highs->outdoor_humidity = highs->indoor_temperature = highs->outdoor_temperature = highs->absolute_pressure = highs->average_windspeed = highs->gust_windspeed = highs->total_rain = DBL_MIN;
+lows->light = DBL_MAX;
+highs->light = 0;
+lows->uv = 0xFF;
+highs->uv = 0;
+highs->has_solar = lows->has_solar = MODEL::HAS_SOLAR;
 
 /*
 	Do we have communications?
@@ -820,7 +1651,7 @@ if (fixed_block == NULL)
 
 rain_overflow = false;
 lost_communications = false;
-address = fixed_block->current_position;
+address = std::reverse_iterator<usb_weather_ring_iterator<MODEL> >(usb_weather_ring<MODEL>::end(fixed_block->current_position));
 max_reads = fixed_block->data_count;
 time = 0;
 reading = NULL;
@@ -830,7 +1661,7 @@ while (!finish)
 	{
 	delete reading;
 
-	if ((reading = read_reading(address)) == NULL)
+	if ((reading = read_reading<MODEL>(*address)) == NULL)
 		return NULL;
 
 	time += reading->delay;
@@ -843,6 +1674,11 @@ while (!finish)
 	COMPUTE_MAX_MIN(average_windspeed);
 	COMPUTE_MAX_MIN(gust_windspeed);
 	COMPUTE_MAX_MIN(total_rain);
+	if (MODEL::HAS_SOLAR)
+		{
+		COMPUTE_MAX_MIN(light);
+		COMPUTE_MAX_MIN(uv);
+		}
 #undef COMPUTE_MAX_MIN
 	rain_overflow = rain_overflow || reading->rain_counter_overflow;
 	lost_communications = lost_communications || reading->lost_communications;
@@ -853,13 +1689,49 @@ while (!finish)
 	if (time > 60 * 24)
 		finish = true;
 
-	if ((address -= 16) < 0x100)
-		address = 0x10000 - sizeof(usb_weather_reading_raw);
+	++address;
 	}
 
 highs->delay = lows->delay = time;
 highs->rain_counter_overflow = lows->rain_counter_overflow = rain_overflow;
 highs->lost_communications = lows->lost_communications = lost_communications;
+delete reading;
 
 return highs;
 }
+
+/*
+	USB_WEATHER::READ_HIGHS_AND_LOWS()
+	----------------------------------
+*/
+usb_weather_reading *usb_weather::read_highs_and_lows(usb_weather_reading *highs, usb_weather_reading *lows, uint32_t since_minutes_ago)
+{
+return model == usb_weather_model_3080::MODEL ? read_highs_and_lows<usb_weather_model_3080>(highs, lows, since_minutes_ago) : read_highs_and_lows<usb_weather_model_1080>(highs, lows, since_minutes_ago);
+}
+
+#ifndef _MSC_VER
+	/*
+		USB_WEATHER::MAKE_DIRECTORY_FOR()
+		---------------------------------
+		Make the directory filename is to go in, if it isn't there already (the one level, readable by anyone but
+		only writable by us).  Return an error code (or 0 for success).
+	*/
+	uint32_t usb_weather::make_directory_for(const char *filename)
+	{
+	char directory[1024];
+	char *slash;
+
+	if (strlen(filename) >= sizeof(directory))
+		return 1;		// name too long
+
+	strcpy(directory, filename);
+	if ((slash = strrchr(directory, '/')) == NULL || slash == directory)
+		return 0;		// the current directory, or /
+	*slash = '\0';
+
+	if (mkdir(directory, 0755) != 0 && errno != EEXIST)
+		return 2;		// can't make it
+
+	return 0;
+	}
+#endif
@@ -10,12 +10,14 @@
 #ifdef _MSC_VER
 	#include <Windows.h>
 #elif defined(__APPLE__)
+	#include <queue>
 	#include <IOKit/hid/IOHIDLib.h>
 	#include <IOKit/hid/IOHIDDevice.h>
 	typedef IOHIDDeviceRef HANDLE;
 	typedef long DWORD;
 	#define INVALID_HANDLE_VALUE NULL
 #else
+	#include <time.h>
 	typedef int HANDLE;
 	typedef long DWORD;
 	#define INVALID_HANDLE_VALUE -1
@@ -23,7 +25,31 @@
 
 #include "fundamental_types.h"
 #include "usb_weather_fixed_block_1080.h"
+#include "usb_weather_model.h"
 #include "usb_weather_reading.h"
+#include "usb_weather_reading_compact.h"
+#include "usb_weather_reading_raw.h"
+#include "usb_weather_statistics.h"
+
+class usb_weather_history;
+class mac_hid_message_object;
+
+/*
+	Where the daemon keeps what only it (and root) should be able to change while it runs
+*/
+#define USB_WEATHER_RUN_DIRECTORY "/run/usb_weather"
+
+/*
+	Where to remember which device each station was last found on (so that we can go straight back to it)
+*/
+#define USB_WEATHER_DISCOVERY_FILE "/var/tmp/usb_weather.devices"
+
+/*
+	USB_WEATHER_BLOCK_CALLBACK
+	--------------------------
+	Called by usb_weather::read_many() with each block (which is the index into the list of addresses) as it arrives
+*/
+typedef void (*usb_weather_block_callback)(void *context, uint32_t which, const uint8_t *block);
 
 /*
 	class USB_WEATHER
@@ -34,23 +60,106 @@ class usb_weather
 private:
 	HANDLE hDevice;
 	usb_weather_fixed_block_1080 *fixed_block;
+	uint32_t timeout_in_ms;				// how long to wait for the station to answer
+	long flush_before_next;				// the last request failed so its reply might still be on its way
+	uint32_t model;						// 1080 or 3080 (which determines the layout of the history ring)
+	uint32_t vid, pid, which;			// what we last connect()ed to (so that we can reconnect())
+
+#ifndef _MSC_VER
+private:
+	uint8_t hid_report_number;			// the report number of the last request (which we put at the start of each reply)
+
+private:
+	long ReadFile(HANDLE hDevice, void *buffer, DWORD bytes_to_read, DWORD *bytes_read, void *ignore);
+	long HidD_SetOutputReport(HANDLE hDevice, void *message, DWORD message_length);
+	long HidD_FlushQueue(HANDLE hDevice);
+#endif
+
+#ifdef __APPLE__
+private:
+	uint8_t mac_hid_buffer[1024];								// where the HID manager puts each report
+	std::queue<mac_hid_message_object *> message_queue;		// reports that have arrived but not yet been read
+#elif !defined(_MSC_VER)
+private:
+	static const long MAX_DEVICES = 256;		// hidraw devices we look at
+
+private:
+	char device_path[32];						// the hidraw device we're connected to ("" if none)
+
+private:
+	void deadline(struct timespec *when);
+	long wait_for(HANDLE hDevice, short events, const struct timespec *deadline);
+	static long is_station(const char *device_name, uint32_t vid, uint32_t pid);
+	static long enumerate(uint32_t vid, uint32_t pid, long *ids, long max_ids);
+	static long discovery_lookup(uint32_t vid, uint32_t pid, uint32_t which, char *path, size_t length);
+	static void discovery_store(uint32_t vid, uint32_t pid, uint32_t which, const char *path);
+	uint32_t open_device(const char *path);
+#endif
+
+private:
+	void disconnect(void);
+
+private:
+	template <class MODEL> static void decode_record(usb_weather_reading *answer, const uint8_t *raw);
+	template <class MODEL> static uint32_t reading_addresses(usb_weather_ring_iterator<MODEL> first, usb_weather_ring_iterator<MODEL> last, uint16_t *addresses, uint8_t *records);
+	template <class MODEL> static void decode_block(void *context, uint32_t which, const uint8_t *block);
+	template <class MODEL> usb_weather_reading *read_reading(uint16_t address);
+	template <class MODEL> uint32_t read_raw_readings(usb_weather_ring_iterator<MODEL> first, usb_weather_ring_iterator<MODEL> last, uint8_t *into);
+	template <class MODEL> usb_weather_reading **read_readings(usb_weather_ring_iterator<MODEL> first, usb_weather_ring_iterator<MODEL> last);
+	template <class MODEL> uint32_t read_compact_readings(uint16_t address, uint32_t count, usb_weather_reading_compact *into);
+	template <class MODEL> uint32_t read_history(usb_weather_history *history, int32_t max_readings);
+	template <class MODEL> usb_weather_reading *read_hourly_delta(void);
+	template <class MODEL> usb_weather_reading *read_highs_and_lows(usb_weather_reading *highs, usb_weather_reading *lows, uint32_t since_minutes_ago);
 
 protected:
-	virtual uint32_t read(uint16_t address, void *result);
+	usb_weather_statistics statistics;	// what we've been doing (and how long it took)
+
+protected:
+	uint32_t read_with_retry(uint16_t address, void *result);
 
 public:
 	usb_weather();
 	virtual ~usb_weather();
-	uint32_t connect(uint32_t vid, uint32_t pid);
+	uint32_t connect(uint32_t vid, uint32_t pid, uint32_t which = 0);
+	virtual uint32_t reconnect(void);
+	const char *get_device_path(void);
+
+	virtual long request(uint16_t address);
+	virtual uint32_t receive(void *result);
+	virtual uint32_t pipeline_depth(void) { return 1; }			// the station answers one request at a time
+	virtual uint32_t read(uint16_t address, void *result);
+	uint32_t read_many(const uint16_t *addresses, uint32_t count, uint8_t *into, usb_weather_block_callback callback = NULL, void *context = NULL);
+	void set_timeout(uint32_t milliseconds);
+	uint32_t get_timeout(void) { return timeout_in_ms; }
+	usb_weather_statistics *get_statistics(void) { return &statistics; }
+	void set_model(uint32_t model) { this->model = model == 3080 ? 3080 : 1080; }
+	uint32_t get_model(void) { return model; }
+	uint32_t get_record_size(void) { return model == 3080 ? 20 : 16; }
+	uint32_t get_ring_slots(void) { return (0x10000 - 0x100) / get_record_size(); }
+
+	static void decode_reading(usb_weather_reading *answer, const usb_weather_reading_raw *raw);
 
 	usb_weather_reading *read_reading(uint16_t address);
+	uint16_t history_address(uint32_t readings_ago);
+	uint32_t readings_between(uint16_t from, uint16_t to);
+	uint32_t read_raw_readings(uint16_t address, uint32_t count, uint8_t *into);
+	usb_weather_reading **read_readings(uint16_t address, uint32_t count);
+	uint32_t read_compact_readings(uint16_t address, uint32_t count, usb_weather_reading_compact *into);
 	usb_weather_fixed_block_1080 *read_fixed_block(void);
-	usb_weather_reading *read_current_readings(void);
+	usb_weather_fixed_block_1080 *reload_fixed_block(void);
+	long probe_fixed_block(void);
+	virtual usb_weather_reading *read_current_readings(void);
 	usb_weather_reading *read_previous_readings(void);
 	usb_weather_reading *read_hourly_delta(void);
 	usb_weather_reading *interpolate_hourly_delta(usb_weather_reading *delta);
 	usb_weather_reading **read_all_readings(uint32_t *readings, int32_t max_readings = -1);
+	uint32_t read_history(usb_weather_history *history, int32_t max_readings = -1);
 	usb_weather_reading *read_highs_and_lows(usb_weather_reading *highs, usb_weather_reading *lows, uint32_t since_minutes_ago = 24 * 60);
+
+#ifndef _MSC_VER
+public:
+	static uint32_t make_directory_for(const char *filename);
+#endif
 } ;
 
 #endif /* USB_WEATHER_H_ */
@@ -6,17 +6,331 @@
 */
 
 #include <stdio.h>
+#include <stddef.h>
 #include <string.h>
+#ifndef _MSC_VER
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sched.h>
+#endif
+#include "usb_weather_reading_raw.h"
 #include "usb_weather_cache.h"
 
+/*
+	LINE_BITS()
+	-----------
+	The bits of the given line's bitmap that are the bytes from address up to (but not including) end
+*/
+static inline uint16_t line_bits(uint32_t line, uint32_t address, uint32_t end)
+{
+uint32_t start, from, to;
+
+start = line * usb_weather_cache_image::LINE_SIZE;
+from = start < address ? address - start : 0;
+to = start + usb_weather_cache_image::LINE_SIZE > end ? end - start : usb_weather_cache_image::LINE_SIZE;
+
+return (uint16_t)(((1 << to) - 1) & ~((1 << from) - 1));
+}
+
+/*
+	USB_WEATHER_CACHE_IMAGE::CLEAR()
+	--------------------------------
+*/
+void usb_weather_cache_image::clear(void)
+{
+memset(this, 0, sizeof(*this));
+magic = MAGIC;
+version = VERSION;
+}
+
 /*
 	USB_WEATHER_CACHE::USB_WEATHER_CACHE()
 	--------------------------------------
 */
 usb_weather_cache::usb_weather_cache()
 {
-memset(memory_map, 0, sizeof(memory_map));
-memset(have_read, 0, sizeof(have_read));
+image = new usb_weather_cache_image;
+image->clear();
+mapped = false;
+source = NULL;
+pending_address = 0;
+pending_hit = false;
+in_flight = 0;
+last_address = 0;
+last_step = direction = 0;
+ahead = 0;
+ahead_reads = 0;
+background = false;
+#ifndef _MSC_VER
+	pthread_mutex_init(&mutex, NULL);
+	pthread_cond_init(&work, NULL);
+	stopping = false;
+#endif
+}
+
+/*
+	USB_WEATHER_CACHE::CONNECT()
+	----------------------------
+	Cache some other station (such as a usb_weather_simulator) rather than the one on the USB.  The source
+	must already be connected.  Return an error code (or 0 for success)
+*/
+uint32_t usb_weather_cache::connect(usb_weather *source)
+{
+this->source = source;
+
+if (read_fixed_block() == NULL)
+	return 3;	// cannot read the fixed block.
+
+return 0;
+}
+
+/*
+	USB_WEATHER_CACHE::RECONNECT()
+	------------------------------
+	If we're layered over some other station then it's that station's job to reconnect, so we just re-read the fixed block
+*/
+uint32_t usb_weather_cache::reconnect(void)
+{
+if (source == NULL)
+	return usb_weather::reconnect();
+
+invalidate(0, sizeof(usb_weather_fixed_block_1080));
+return reload_fixed_block() == NULL ? 3 : 0;
+}
+
+/*
+	USB_WEATHER_CACHE::~USB_WEATHER_CACHE()
+	---------------------------------------
+*/
+usb_weather_cache::~usb_weather_cache()
+{
+#ifndef _MSC_VER
+	if (background)
+		{
+		pthread_mutex_lock(&mutex);
+		stopping = true;
+		pthread_cond_signal(&work);
+		pthread_mutex_unlock(&mutex);
+		pthread_join(prefetcher, NULL);
+		}
+	pthread_cond_destroy(&work);
+	pthread_mutex_destroy(&mutex);
+
+	if (mapped)
+		{
+		munmap(image, sizeof(*image));
+		return;
+		}
+#endif
+delete image;
+}
+
+/*
+	USB_WEATHER_CACHE::ATTACH()
+	---------------------------
+	Keep the cache in the given file so that it survives from one run to the next (and is shared between
+	processes).  History never changes once written so we can trust it, but the fixed block and the current
+	reading do, so we forget those.  Call sync() after connect() to catch up with anything written since the
+	file was last used.  Return an error code (or 0 for success).
+*/
+uint32_t usb_weather_cache::attach(const char *filename)
+{
+#ifdef _MSC_VER
+	return 1;		// not supported
+#else
+	usb_weather_cache_image *file_image;
+	int file;
+
+	if ((file = open(filename, O_RDWR | O_CREAT, 0600)) < 0)
+		return 1;		// can't open the file
+
+	if (ftruncate(file, sizeof(*file_image)) != 0)
+		{
+		close(file);
+		return 2;		// can't make it the right size
+		}
+
+	file_image = (usb_weather_cache_image *)mmap(NULL, sizeof(*file_image), PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	close(file);
+	if (file_image == MAP_FAILED)
+		return 3;		// can't map it
+
+	/*
+		Is it one of ours (of this version)?
+	*/
+	if (file_image->magic != usb_weather_cache_image::MAGIC || file_image->version != usb_weather_cache_image::VERSION)
+		file_image->clear();
+
+	if (mapped)
+		munmap(image, sizeof(*image));
+	else
+		delete image;
+	image = file_image;
+	mapped = true;
+
+	/*
+		Forget the parts that might have changed since the file was written
+	*/
+	invalidate(0, sizeof(usb_weather_fixed_block_1080));
+	if (image->synced)
+		invalidate_readings(image->synced_position, 2);
+
+	return 0;
+#endif
+}
+
+/*
+	USB_WEATHER_CACHE::IS_CURRENT()
+	-------------------------------
+	Is the given line (partly) the reading the station is currently writing (according to the fixed block we have)?
+*/
+long usb_weather_cache::is_current(uint32_t line)
+{
+static const uint32_t at = offsetof(usb_weather_fixed_block_1080, current_position);
+uint32_t position;
+
+if ((image->have[at / usb_weather_cache_image::LINE_SIZE] >> (at % usb_weather_cache_image::LINE_SIZE) & 3) != 3)
+	return false;			// we don't know where the current reading is
+
+position = image->memory_map[at] | (image->memory_map[at + 1] << 8);
+
+return position >= 0x100 && line * usb_weather_cache_image::LINE_SIZE < position + get_record_size() && (line + 1) * usb_weather_cache_image::LINE_SIZE > position;
+}
+
+/*
+	USB_WEATHER_CACHE::FRESH()
+	--------------------------
+	Can we still trust what we have of the given line?  History never changes once written so that's kept for
+	ever, but the fixed block and the current reading are only good for a short while.  A line of history that
+	has since become the current reading (because the station has moved on to it) can't be trusted either.  A
+	line that can't be trusted is forgotten.
+*/
+long usb_weather_cache::fresh(uint32_t line, uint32_t now)
+{
+if (image->expires[line] == 0 ? !is_current(line) : now < image->expires[line])
+	return true;
+
+image->have[line] = 0;
+return false;
+}
+
+/*
+	USB_WEATHER_CACHE::REMEMBER()
+	-----------------------------
+	Put the 32 bytes the station gave us for the given address in the cache (a read past the end of memory
+	only gets the part of it that is in memory)
+*/
+void usb_weather_cache::remember(uint16_t address, const void *data)
+{
+uint32_t line, end, now;
+uint16_t bits;
+
+end = (uint32_t)address + 32 > 0x10000 ? 0x10000 : (uint32_t)address + 32;
+memcpy(image->memory_map + address, data, end - address);
+
+now = (uint32_t)time(NULL);
+for (line = address / usb_weather_cache_image::LINE_SIZE; line * usb_weather_cache_image::LINE_SIZE < end; line++)
+	{
+	bits = line_bits(line, address, end);
+
+	/*
+		The line is as old as the oldest part of it
+	*/
+	if (!fresh(line, now) || image->have[line] == 0 || bits == 0xFFFF)
+		image->expires[line] = line * usb_weather_cache_image::LINE_SIZE < sizeof(usb_weather_fixed_block_1080) || is_current(line) ? now + TTL : 0;
+	image->have[line] |= bits;
+	}
+}
+
+/*
+	USB_WEATHER_CACHE::RECALL()
+	---------------------------
+	Get the 32 bytes at address out of the cache (what's past the end of memory comes back as 0)
+*/
+void usb_weather_cache::recall(uint16_t address, void *result)
+{
+uint32_t length;
+
+length = (uint32_t)address + 32 > 0x10000 ? 0x10000 - address : 32;
+memcpy(result, image->memory_map + address, length);
+memset((uint8_t *)result + length, 0, 32 - length);
+}
+
+/*
+	USB_WEATHER_CACHE::FETCH()
+	--------------------------
+	Read from the device (or whatever we're layered over) and remember what we got.  This goes straight to the
+	device rather than through our own request() and receive() so that it isn't taken for something asked for.
+*/
+uint32_t usb_weather_cache::fetch(uint16_t address, void *result)
+{
+uint32_t got;
+
+if (source == NULL)
+	got = usb_weather::request(address) ? usb_weather::receive(result) : 0;
+else
+	got = source->read(address, result);
+
+if (got != 0)
+	remember(address, result);
+
+return got;
+}
+
+/*
+	USB_WEATHER_CACHE::REQUEST()
+	----------------------------
+	If we already have what's being asked for then there's no need to go to the device for it
+*/
+long usb_weather_cache::request(uint16_t address)
+{
+long sent;
+
+pending_address = address;
+note(address);
+if ((pending_hit = have(address, 32)))
+	return true;
+
+/*
+	A miss in the middle of a scan.  If nothing else is on the wire then read this and what comes next all at
+	once (as long as whatever we're layered over can have them all in flight together, otherwise there's
+	nothing to gain).
+*/
+if (!background && direction != 0 && in_flight == 0 && source != NULL && source->pipeline_depth() > 1)
+	{
+	ahead = address;
+	prefetch();
+	if ((pending_hit = have(address, 32)))
+		return true;
+	}
+
+if ((sent = source == NULL ? usb_weather::request(address) : source->request(address)))
+	in_flight++;
+
+return sent;
+}
+
+/*
+	USB_WEATHER_CACHE::RECEIVE()
+	----------------------------
+*/
+uint32_t usb_weather_cache::receive(void *result)
+{
+uint32_t got;
+
+if (pending_hit)
+	{
+	recall(pending_address, result);
+	return 32;
+	}
+
+if (in_flight > 0)
+	in_flight--;
+if ((got = source == NULL ? usb_weather::receive(result) : source->receive(result)) != 0)
+	remember(pending_address, result);
+
+return got;
 }
 
 /*
@@ -25,41 +339,434 @@ memset(have_read, 0, sizeof(have_read));
 */
 uint32_t usb_weather_cache::read(uint16_t address, void *result)
 {
-uint32_t got, here, sum = 0;
+uint32_t here;
+long first_half, second_half;
 uint8_t buffer[32];
 
-for (here = address; here < (uint32_t)address + 32; here++)
-	sum += have_read[here];
+note(address);
+first_half = have(address, 16);
+second_half = have((uint32_t)address + 16, 16);
 
-if (sum == 32)
+if (first_half && second_half)
 	{
 	/*
 		We've done this read before, so get the result out of the cache
 	*/
-	memcpy(result, memory_map + address, 32);
+	recall(address, result);
 	return 32;
 	}
-else if (sum == 16)
+else if (first_half || second_half)
 	{
 	/*
-		We've done half this read before so adjust it to read all new material
+		We've done half this read before so adjust it to read all new material.  Go to the device for the
+		other half (rather than through the cache) as its neighbour might only be half there too.
 	*/
-	if (have_read[address])
-		read(address + 16, buffer);
-	else
-		read(address - 16, buffer);
+	here = first_half ? (uint32_t)address + 16 : (uint32_t)address - 16;
+	if (here >= 0x100 && here + 32 <= 0x10000 && fetch((uint16_t)here, buffer) != 0 && have(address, 32))
+		{
+		recall(address, result);
+		return 32;
+		}
+	}
+
+/*
+	Entirely new read
+*/
+return fetch(address, result);
+}
+
+/*
+	USB_WEATHER_CACHE::STEP()
+	-------------------------
+	The next read after the one at address, going in the given direction through the history ring
+*/
+uint16_t usb_weather_cache::step(uint16_t address, int32_t direction)
+{
+if (direction > 0)
+	return (uint32_t)address + 32 >= 0x10000 ? 0x100 : address + 32;
+else if (address <= 0x100)
+	return 0x10000 - 32;
+else
+	return address < 0x100 + 32 ? 0x100 : address - 32;
+}
+
+/*
+	USB_WEATHER_CACHE::NOTE()
+	-------------------------
+	Someone has asked for the 32 bytes at address.  If that's the second step in a row the same way through the
+	history then it's a scan, so keep PREFETCH_READS reads ahead of it.
+*/
+void usb_weather_cache::note(uint16_t address)
+{
+int32_t distance, this_step;
+
+distance = (int32_t)address - (int32_t)last_address;
+this_step = address < 0x100 || last_address < 0x100 || distance == 0 || distance > 32 || distance < -32 ? 0 : distance > 0 ? 1 : -1;
+direction = this_step != 0 && this_step == last_step ? this_step : 0;
+last_step = this_step;
+last_address = address;
 
-	return read(address, result);
+if (direction == 0)
+	return;
+
+ahead = step(address, direction);
+ahead_reads = PREFETCH_READS;
+#ifndef _MSC_VER
+	if (background)
+		pthread_cond_signal(&work);
+#endif
+}
+
+/*
+	USB_WEATHER_CACHE::PREFETCH()
+	-----------------------------
+	Do up to max_reads (all of them if max_reads < 0) of the reads ahead of the scan, skipping what we already
+	have.  Returns the number of reads ahead still to do.
+*/
+uint32_t usb_weather_cache::prefetch(long max_reads)
+{
+uint16_t addresses[PREFETCH_READS];
+uint8_t buffer[PREFETCH_READS * 32];
+uint32_t wanted, got, current;
+
+wanted = 0;
+while (ahead_reads > 0 && (max_reads < 0 || wanted < (uint32_t)max_reads))
+	{
+	if (!have(ahead, 32))
+		addresses[wanted++] = ahead;
+	ahead = step(ahead, direction);
+	ahead_reads--;
+	}
+
+if (source != NULL)
+	{
+	got = source->read_many(addresses, wanted, buffer);
+	for (current = 0; current < got; current++)
+		remember(addresses[current], buffer + current * 32);
+	}
+else
+	for (current = 0; current < wanted; current++)
+		if (fetch(addresses[current], buffer) == 0)
+			break;
+
+return ahead_reads;
+}
+
+/*
+	USB_WEATHER_CACHE::PREFETCH_THREAD()
+	------------------------------------
+	Read ahead of scans one read at a time, letting go of the cache between reads so that whoever is scanning
+	can get at it
+*/
+void *usb_weather_cache::prefetch_thread(void *cache)
+{
+#ifndef _MSC_VER
+	usb_weather_cache *self = (usb_weather_cache *)cache;
+
+	pthread_mutex_lock(&self->mutex);
+	while (!self->stopping)
+		{
+		if (self->ahead_reads == 0 || self->direction == 0)
+			pthread_cond_wait(&self->work, &self->mutex);
+		else
+			{
+			self->prefetch(1);
+			pthread_mutex_unlock(&self->mutex);
+			sched_yield();
+			pthread_mutex_lock(&self->mutex);
+			}
+		}
+	pthread_mutex_unlock(&self->mutex);
+#endif
+
+return NULL;
+}
+
+/*
+	USB_WEATHER_CACHE::START_PREFETCHING()
+	--------------------------------------
+	Read ahead of scans on a thread of our own.  From then on hold lock() while using the cache (or the station
+	through it).  Returns 0 on success.
+*/
+uint32_t usb_weather_cache::start_prefetching(void)
+{
+#ifdef _MSC_VER
+	return 1;		// not supported
+#else
+	if (background)
+		return 0;
+
+	stopping = false;
+	if (pthread_create(&prefetcher, NULL, prefetch_thread, this) != 0)
+		return 1;
+	background = true;
+
+	return 0;
+#endif
+}
+
+/*
+	USB_WEATHER_CACHE::LOCK()
+	-------------------------
+*/
+void usb_weather_cache::lock(void)
+{
+#ifndef _MSC_VER
+	pthread_mutex_lock(&mutex);
+#endif
+}
+
+/*
+	USB_WEATHER_CACHE::UNLOCK()
+	---------------------------
+*/
+void usb_weather_cache::unlock(void)
+{
+#ifndef _MSC_VER
+	pthread_mutex_unlock(&mutex);
+#endif
+}
+
+/*
+	USB_WEATHER_CACHE::SNAPSHOT()
+	-----------------------------
+	Copy the station's memory and which bytes of it we can still trust (laid out as in usb_weather_cache_image)
+	into memory_map and have.  Returns when (as for time()) the first of it stops being good, or 0 if it's all
+	history (which is good for ever).
+*/
+uint32_t usb_weather_cache::snapshot(uint8_t *memory_map, uint16_t *have)
+{
+uint32_t line, now, expires;
+
+memcpy(memory_map, image->memory_map, sizeof(image->memory_map));
+
+now = (uint32_t)time(NULL);
+expires = 0;
+for (line = 0; line < usb_weather_cache_image::LINES; line++)
+	{
+	have[line] = fresh(line, now) ? image->have[line] : 0;
+	if (have[line] != 0 && image->expires[line] != 0 && (expires == 0 || image->expires[line] < expires))
+		expires = image->expires[line];
+	}
+
+return expires;
+}
+
+/*
+	USB_WEATHER_CACHE::INVALIDATE()
+	-------------------------------
+	Forget what we know about the given range of memory so that the next read goes back to the station
+*/
+void usb_weather_cache::invalidate(uint32_t address, uint32_t length)
+{
+uint32_t line, end;
+
+if (address >= 0x10000)
+	return;
+end = address + length > 0x10000 ? 0x10000 : address + length;
+
+for (line = address / usb_weather_cache_image::LINE_SIZE; line * usb_weather_cache_image::LINE_SIZE < end; line++)
+	{
+	image->have[line] &= (uint16_t)~line_bits(line, address, end);
+	}
+}
+
+/*
+	USB_WEATHER_CACHE::INVALIDATE_READINGS()
+	----------------------------------------
+	Forget count consecutive readings starting at address (wrapping from the end of the ring back to 0x100)
+*/
+void usb_weather_cache::invalidate_readings(uint16_t address, uint32_t count)
+{
+uint32_t length, first;
+
+length = count * get_record_size();
+while (length > 0)
+	{
+	first = 0x10000 - address < length ? 0x10000 - address : length;
+	invalidate(address, first);
+	length -= first;
+	address = 0x100;
+	}
+}
+
+/*
+	USB_WEATHER_CACHE::SYNC()
+	-------------------------
+	Bring the cache up to date with the station (re-reading the fixed block unless the caller has just done so).
+	The station only ever changes the reading at current_position (every 48 seconds or so) and moves current_position on by one reading every read_period minutes, so since the
+	last sync only the readings from the last current_position to the new current_position can have changed.  We
+	re-read those and trust the rest.  If the history has been reset (or has wrapped all the way around the ring
+	since we last looked) then we start again.  Returns the number of readings read from the station (0 if it has
+	not moved on to a new reading), or -1 on error.
+*/
+long usb_weather_cache::sync(long fixed_block_is_current)
+{
+usb_weather_fixed_block_1080 *block;
+uint32_t advanced, expected_count, wanted, got, slots;
+uint16_t first;
+uint8_t *buffer;
+time_t now;
+long changed;
+
+/*
+	Get the current state of the station
+*/
+now = time(NULL);
+slots = get_ring_slots();
+if (fixed_block_is_current)
+	block = read_fixed_block();
+else
+	{
+	/*
+		Most of the time the station is still writing the same reading as last time, which we can tell from the
+		first 32 bytes of the fixed block alone.  If so then all that has changed is the current reading and the
+		rest of the fixed block (the clock, the pressure, and the highs and lows) so we forget those and leave them
+		to be fetched when they're next asked for.  A poll then costs one read.
+	*/
+	invalidate(0, 32);
+	if ((changed = probe_fixed_block()) < 0)
+		return -1;
+	block = read_fixed_block();
+	if (!changed && image->synced && block->current_position == image->synced_position && (now - image->synced_time) / 60 < (time_t)slots * block->read_period)
+		{
+		invalidate(32, sizeof(*block) - 32);
+		invalidate_readings(block->current_position, 1);
+		image->synced_time = now;
+		return 0;
+		}
+
+	invalidate(32, sizeof(*block) - 32);
+	block = reload_fixed_block();
+	}
+if (block == NULL)
+	return -1;
+
+advanced = readings_between(image->synced_position, block->current_position);
+expected_count = image->synced_count + advanced < slots ? image->synced_count + advanced : slots;
+
+if (!image->synced || block->data_count != expected_count || (now - image->synced_time) / 60 >= (time_t)(slots - advanced) * block->read_period)
+	{
+	/*
+		First time, or the history has been cleared, or we've been away so long the whole ring has been re-written.
+		Nothing we have can be trusted so start again (call fill() to fetch the history rather than waiting for it
+		to be asked for)
+	*/
+	invalidate(0x100, 0x10000 - 0x100);
+	wanted = 1;
+	first = block->current_position;
 	}
 else
 	{
 	/*
-		Entirely new read
+		The reading at the old current_position has been finalised and those after it are new
+		(the one after the current reading is also in the cache as it came in with the current reading)
 	*/
-	got = usb_weather::read(address, result);
-	memcpy(memory_map + address, result, 32);
-	memset(have_read + address, 1, 32);
+	wanted = advanced + 1;
+	first = image->synced_position;
+	invalidate_readings(first, wanted + 1);
+	}
+
+/*
+	Read them (which puts them in the cache)
+*/
+buffer = new uint8_t [wanted * get_record_size()];
+got = read_raw_readings(first, wanted, buffer);
+delete [] buffer;
+
+if (got != wanted)
+	{
+	image->synced = false;
+	return -1;
+	}
 
-	return got;
+image->synced = true;
+image->synced_position = block->current_position;
+image->synced_count = block->data_count;
+image->synced_time = now;
+
+return got;
+}
+
+/*
+	USB_WEATHER_CACHE::HAVE()
+	-------------------------
+	Return true if the given range of memory is all in the cache (and can still be trusted).  Anything past the end
+	of memory doesn't count.
+*/
+long usb_weather_cache::have(uint32_t address, uint32_t length)
+{
+uint32_t line, end, now;
+uint16_t wanted;
+
+if (address >= 0x10000)
+	return true;
+end = address + length > 0x10000 ? 0x10000 : address + length;
+
+now = (uint32_t)time(NULL);
+for (line = address / usb_weather_cache_image::LINE_SIZE; line * usb_weather_cache_image::LINE_SIZE < end; line++)
+	{
+	wanted = line_bits(line, address, end);
+	if ((image->have[line] & wanted) != wanted || !fresh(line, now))
+		return false;
 	}
+
+return true;
+}
+
+/*
+	USB_WEATHER_CACHE::FILL()
+	-------------------------
+	Fetch the history that isn't already in the cache (most recent first), doing no more than max_reads reads
+	(all of them if max_reads < 0).  Returns the number of readings still missing, or -1 on error.
+*/
+template <class MODEL>
+long usb_weather_cache::fill(long max_reads)
+{
+std::reverse_iterator<usb_weather_ring_iterator<MODEL> > at, oldest;
+usb_weather_fixed_block_1080 *block;
+uint16_t *addresses;
+uint8_t *buffer;
+uint32_t blocks = 0;
+long missing = 0;
+
+if ((block = read_fixed_block()) == NULL)
+	return -1;
+
+/*
+	Work out what to read
+*/
+addresses = new uint16_t [block->data_count + 1];
+oldest = std::reverse_iterator<usb_weather_ring_iterator<MODEL> >(usb_weather_ring<MODEL>::begin(block->current_position, block->data_count));
+for (at = std::reverse_iterator<usb_weather_ring_iterator<MODEL> >(usb_weather_ring<MODEL>::end(block->current_position)); at < oldest; ++at)
+	if (!have(*at, MODEL::RECORD_SIZE))
+		{
+		if (max_reads >= 0 && blocks >= (uint32_t)max_reads)
+			missing++;
+		else if (2 * MODEL::RECORD_SIZE <= 32 && *at >= MODEL::FIRST_RECORD + MODEL::RECORD_SIZE)
+			addresses[blocks++] = *++at;			// read the reading before this one too as it fits in the same read (we're going backwards)
+		else
+			addresses[blocks++] = *at;
+		}
+
+/*
+	Then read it all in one go
+*/
+buffer = new uint8_t [blocks * 32 + 1];
+if (read_many(addresses, blocks, buffer) != blocks)
+	missing = -1;
+
+delete [] buffer;
+delete [] addresses;
+
+return missing;
+}
+
+/*
+	USB_WEATHER_CACHE::FILL()
+	-------------------------
+*/
+long usb_weather_cache::fill(long max_reads)
+{
+return get_model() == usb_weather_model_3080::MODEL ? fill<usb_weather_model_3080>(max_reads) : fill<usb_weather_model_1080>(max_reads);
 }
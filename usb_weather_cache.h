@@ -7,25 +7,127 @@
 #ifndef USB_WEATHER_CACHE_H_
 #define USB_WEATHER_CACHE_H_
 
+#include <time.h>
+#ifndef _MSC_VER
+	#include <pthread.h>
+#endif
 #include "usb_weather.h"
 
+/*
+	Where to keep the cache between runs
+*/
+#define USB_WEATHER_CACHE_FILE "/var/tmp/usb_weather.cache"
+
+/*
+	class USB_WEATHER_CACHE_IMAGE
+	-----------------------------
+	The contents of the cache, either in memory or (if attached) in a file that is shared by all processes.  The
+	station's memory is kept in 16-byte lines, each with a bitmap of which of its bytes we have and a time after
+	which they can't be trusted.
+*/
+class usb_weather_cache_image
+{
+public:
+	static const uint32_t MAGIC = 0x57483130;		// "WH10"
+	static const uint32_t VERSION = 2;
+	static const uint32_t LINE_SIZE = 16;
+	static const uint32_t LINES = 0x10000 / LINE_SIZE;
+
+public:
+	uint32_t magic;
+	uint32_t version;
+
+	/*
+		The state of the station the last time we synchronised with it
+	*/
+	uint32_t synced;
+	uint32_t synced_position;				// current_position in the fixed block
+	uint32_t synced_count;					// data_count in the fixed block
+	int64_t synced_time;					// when (our clock)
+
+	/*
+		The station's memory, which bytes of it we have (bit n of a line is byte n of that line), and when each
+		line expires (0 for never)
+	*/
+	uint8_t memory_map[0x10000];
+	uint16_t have[LINES];
+	uint32_t expires[LINES];
+
+public:
+	void clear(void);
+} ;
+
 /*
 	class USB_WEATHER_CACHE
 	-----------------------
+	Remember what the station said so that we don't have to ask again.  When the requests look like a scan
+	through the history (in either direction) we read ahead of them: in the foreground when we're layered over
+	something that can have many requests in flight at once, or on a thread of our own (see start_prefetching())
+	when we're in the daemon.
 */
 class usb_weather_cache : public usb_weather
 {
 private:
-	uint8_t memory_map[0x10000];
-	uint8_t have_read[0x10000];
+	static const uint32_t TTL = 48;			// seconds to trust the fixed block and the current reading for (the station re-writes them that often)
+	static const uint32_t PREFETCH_READS = 16;	// how far to read ahead of a scan (32 lines)
 
-protected:
-	virtual uint32_t read(uint16_t address, void *result);
+private:
+	usb_weather_cache_image *image;
+	long mapped;							// true if image is in a file, false if in memory
+	usb_weather *source;					// where to get what isn't in the cache (NULL for the USB)
+	uint16_t pending_address;				// the last request()
+	long pending_hit;						// true if the last request() can be answered from the cache
+	long in_flight;							// requests passed on (to the station or source) and not yet received
+
+	uint16_t last_address;					// the last address asked for
+	int32_t last_step;						// which way (+1 or -1) that was from the one before, 0 if not close by
+	int32_t direction;						// which way the scan is going (0 if this isn't a scan)
+	uint16_t ahead;							// the next address to read ahead
+	uint32_t ahead_reads;					// the number of reads still to do ahead of the scan
+	long background;						// true if the prefetcher thread is running
+
+#ifndef _MSC_VER
+	pthread_mutex_t mutex;					// held while using the station or the cache (see lock())
+	pthread_cond_t work;					// signalled when there's reading ahead to do
+	pthread_t prefetcher;
+	long stopping;							// tell the prefetcher thread to finish
+#endif
+
+private:
+	uint32_t fetch(uint16_t address, void *result);
+	void remember(uint16_t address, const void *data);
+	void recall(uint16_t address, void *result);
+	long is_current(uint32_t line);
+	long fresh(uint32_t line, uint32_t now);
+	void invalidate_readings(uint16_t address, uint32_t count);
+	long have(uint32_t address, uint32_t length);
+	template <class MODEL> long fill(long max_reads);
+	static uint16_t step(uint16_t address, int32_t direction);
+	void note(uint16_t address);
+	uint32_t prefetch(long max_reads = -1);
+	static void *prefetch_thread(void *cache);
 
 public:
 	usb_weather_cache();
-	virtual ~usb_weather_cache() {}
+	virtual ~usb_weather_cache();
+
+	using usb_weather::connect;
+	uint32_t connect(usb_weather *source);
+	virtual uint32_t reconnect(void);
+	uint32_t attach(const char *filename = USB_WEATHER_CACHE_FILE);
+
+	virtual long request(uint16_t address);
+	virtual uint32_t receive(void *result);
+	virtual uint32_t read(uint16_t address, void *result);
+
+	void invalidate(uint32_t address, uint32_t length);
+	long sync(long fixed_block_is_current = false);
+	long fill(long max_reads = -1);
+	uint32_t snapshot(uint8_t *memory_map, uint16_t *have);
 
+	uint32_t start_prefetching(void);
+	void lock(void);
+	void unlock(void);
 };
 
 #endif /* USB_WEATHER_CACHE_H_ */
@@ -0,0 +1,147 @@
+/*
+	USB_WEATHER_CLIENT.C
+	--------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include "usb_weather_client.h"
+#include "usb_weather_message.h"
+
+/*
+	USB_WEATHER_CLIENT::USB_WEATHER_CLIENT()
+	----------------------------------------
+*/
+usb_weather_client::usb_weather_client()
+{
+server = -1;
+}
+
+/*
+	USB_WEATHER_CLIENT::~USB_WEATHER_CLIENT()
+	-----------------------------------------
+*/
+usb_weather_client::~usb_weather_client()
+{
+if (server >= 0)
+	close(server);
+}
+
+/*
+	USB_WEATHER_CLIENT::TRUSTED()
+	-----------------------------
+	Is the process at the other end of the socket root (or us)?  If the daemon isn't running then anyone could
+	have made a socket at its name, and we'd be showing whatever they sent.
+*/
+long usb_weather_client::trusted(int server)
+{
+#ifdef __linux__
+	struct ucred peer;
+	socklen_t length;
+
+	length = sizeof(peer);
+	if (getsockopt(server, SOL_SOCKET, SO_PEERCRED, &peer, &length) != 0)
+		return false;
+
+	return peer.uid == 0 || peer.uid == geteuid();
+#else
+	uid_t uid;
+	gid_t gid;
+
+	if (getpeereid(server, &uid, &gid) != 0)
+		return false;
+
+	return uid == 0 || uid == geteuid();
+#endif
+}
+
+/*
+	USB_WEATHER_CLIENT::CONNECT()
+	-----------------------------
+	Return an error code (or 0 for success), the codes are the same as for usb_weather::connect()
+*/
+uint32_t usb_weather_client::connect(const char *socket_name)
+{
+struct sockaddr_un address;
+struct timeval timeout = {5, 0};			// the daemon might have to go to the station, but that shouldn't take this long
+
+if (strlen(socket_name) >= sizeof(address.sun_path))
+	return 1;
+
+if ((server = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+	return 1;		// can't connect to the daemon
+
+memset(&address, 0, sizeof(address));
+address.sun_family = AF_UNIX;
+strcpy(address.sun_path, socket_name);
+
+if (::connect(server, (struct sockaddr *)&address, sizeof(address)) != 0 || !trusted(server))
+	{
+	close(server);
+	server = -1;
+	return 2;		// the daemon isn't running
+	}
+
+setsockopt(server, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+setsockopt(server, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+if (read_fixed_block() == NULL)
+	return 3;	// cannot read the fixed block.
+
+return 0;
+}
+
+/*
+	USB_WEATHER_CLIENT::REQUEST()
+	-----------------------------
+*/
+long usb_weather_client::request(uint16_t address)
+{
+usb_weather_message message;
+
+if (server < 0)
+	return false;
+
+message.zero = 0;
+message.report_id = message.aux_report_id = 0xa1;
+message.address_high = message.aux_address_high = (address >> 8) & 0xFF;
+message.address_low = message.aux_address_low = address & 0xFF;
+message.end_of_message = message.aux_end_of_message = 0x20;
+
+return send(server, &message, sizeof(message), MSG_NOSIGNAL) == sizeof(message);
+}
+
+/*
+	USB_WEATHER_CLIENT::RECEIVE()
+	-----------------------------
+*/
+uint32_t usb_weather_client::receive(void *result)
+{
+usb_weather_server_reply reply;
+uint8_t *into;
+ssize_t got;
+size_t remaining;
+
+if (server < 0)
+	return 0;
+
+into = (uint8_t *)&reply;
+remaining = sizeof(reply);
+while (remaining > 0)
+	{
+	if ((got = recv(server, into, remaining, 0)) <= 0)
+		return 0;
+	into += got;
+	remaining -= got;
+	}
+
+if (reply.status != sizeof(reply.data))
+	return 0;
+
+memcpy(result, reply.data, sizeof(reply.data));
+return sizeof(reply.data);
+}
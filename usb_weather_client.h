@@ -0,0 +1,37 @@
+/*
+	USB_WEATHER_CLIENT.H
+	--------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#ifndef USB_WEATHER_CLIENT_H_
+#define USB_WEATHER_CLIENT_H_
+
+#include "usb_weather.h"
+#include "usb_weather_server.h"
+
+/*
+	class USB_WEATHER_CLIENT
+	------------------------
+	Talk to the weather station through the daemon (usb_weather_server) rather than over the USB
+*/
+class usb_weather_client : public usb_weather
+{
+private:
+	int server;
+
+private:
+	static long trusted(int server);
+
+public:
+	usb_weather_client();
+	virtual ~usb_weather_client();
+
+	uint32_t connect(const char *socket_name = USB_WEATHER_SERVER_SOCKET);
+
+	virtual long request(uint16_t address);
+	virtual uint32_t receive(void *result);
+	virtual uint32_t pipeline_depth(void) { return 16; }		// the daemon queues requests in its socket
+} ;
+
+#endif /* USB_WEATHER_CLIENT_H_ */
@@ -0,0 +1,295 @@
+/*
+	USB_WEATHER_HISTORY.C
+	---------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#include <stddef.h>
+#include <string.h>
+#include "usb_weather_history.h"
+#include "usb_weather_model.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define USB_WEATHER_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+	#define USB_WEATHER_NEON
+#endif
+
+/*
+	USB_WEATHER_HISTORY::USB_WEATHER_HISTORY()
+	------------------------------------------
+*/
+usb_weather_history::usb_weather_history()
+{
+memory = NULL;
+capacity = 0;
+readings = 0;
+has_solar = false;
+delay = NULL;
+indoor_humidity = indoor_temperature = outdoor_humidity = outdoor_temperature = absolute_pressure = NULL;
+average_windspeed = gust_windspeed = wind_direction = total_rain = NULL;
+rain_counter_overflow = lost_communications = uv = NULL;
+light = NULL;
+}
+
+/*
+	USB_WEATHER_HISTORY::~USB_WEATHER_HISTORY()
+	-------------------------------------------
+*/
+usb_weather_history::~usb_weather_history()
+{
+delete [] memory;
+}
+
+/*
+	USB_WEATHER_HISTORY::RESIZE()
+	-----------------------------
+	Make room for the given number of readings (the contents are lost if the arrays have to grow)
+*/
+void usb_weather_history::resize(uint32_t readings)
+{
+double *into;
+
+this->readings = readings;
+if (readings <= capacity && memory != NULL)
+	return;
+
+/*
+	The doubles go first so that they are aligned, then the 32-bit integers, then the bytes
+*/
+delete [] memory;
+capacity = readings;
+memory = new uint8_t [capacity * (10 * sizeof(double) + sizeof(uint32_t) + 3 * sizeof(uint8_t)) + sizeof(double)];
+
+into = (double *)memory;
+indoor_humidity = into;
+indoor_temperature = into += capacity;
+outdoor_humidity = into += capacity;
+outdoor_temperature = into += capacity;
+absolute_pressure = into += capacity;
+average_windspeed = into += capacity;
+gust_windspeed = into += capacity;
+wind_direction = into += capacity;
+total_rain = into += capacity;
+light = into += capacity;
+delay = (uint32_t *)(into + capacity);
+rain_counter_overflow = (uint8_t *)(delay + capacity);
+lost_communications = rain_counter_overflow + capacity;
+uv = lost_communications + capacity;
+}
+
+/*
+	USB_WEATHER_HISTORY::SET()
+	--------------------------
+	Store reading which given the integer fields out of the station's record
+*/
+inline void usb_weather_history::set(uint32_t which, uint32_t delay, uint32_t indoor_humidity, int32_t indoor_temperature, uint32_t outdoor_humidity, int32_t outdoor_temperature, uint32_t pressure, uint32_t average, uint32_t gust, uint32_t direction, uint32_t rain, uint32_t status)
+{
+this->delay[which] = delay;
+this->indoor_humidity[which] = indoor_humidity;
+this->indoor_temperature[which] = indoor_temperature / 10.0;
+this->outdoor_humidity[which] = outdoor_humidity;
+this->outdoor_temperature[which] = outdoor_temperature / 10.0;
+absolute_pressure[which] = pressure / 10.0;
+average_windspeed[which] = average / 10.0;
+gust_windspeed[which] = gust / 10.0;
+wind_direction[which] = direction * 22.5;
+total_rain[which] = rain * 0.3;
+rain_counter_overflow[which] = (status >> 7) & 1;
+lost_communications[which] = (status >> 6) & 1;
+}
+
+/*
+	SIGN_MAGNITUDE()
+	----------------
+	Temperatures are stored as sign and magnitude
+*/
+static inline int32_t sign_magnitude(uint32_t value)
+{
+return value < 0x8000 ? (int32_t)value : -(int32_t)(value - 0x8000);
+}
+
+#ifdef USB_WEATHER_SSE2
+	/*
+		STORE_DOUBLES()
+		---------------
+		Store four integers as doubles, divided by divisor (if not 0) and then multiplied by multiplier (if not 0)
+	*/
+	static inline void store_doubles(double *into, __m128i value, double divisor, double multiplier)
+	{
+	__m128d low = _mm_cvtepi32_pd(value);
+	__m128d high = _mm_cvtepi32_pd(_mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2)));
+
+	if (divisor != 0)
+		{
+		low = _mm_div_pd(low, _mm_set1_pd(divisor));
+		high = _mm_div_pd(high, _mm_set1_pd(divisor));
+		}
+	if (multiplier != 0)
+		{
+		low = _mm_mul_pd(low, _mm_set1_pd(multiplier));
+		high = _mm_mul_pd(high, _mm_set1_pd(multiplier));
+		}
+	_mm_storeu_pd(into, low);
+	_mm_storeu_pd(into + 2, high);
+	}
+
+	/*
+		SIGN_MAGNITUDE()
+		----------------
+		Four sign and magnitude 16-bit integers (in the low half of each lane) to two's complement
+	*/
+	static inline __m128i sign_magnitude(__m128i value)
+	{
+	__m128i magnitude = _mm_and_si128(value, _mm_set1_epi32(0x7FFF));
+	__m128i negative = _mm_srai_epi32(_mm_slli_epi32(value, 16), 31);
+
+	return _mm_sub_epi32(_mm_xor_si128(magnitude, negative), negative);
+	}
+#endif
+
+/*
+	USB_WEATHER_HISTORY::DECODE()
+	-----------------------------
+	Convert count consecutive records from a station of the given model (at raw) into human usable units and
+	store them as readings first onwards.  WH1080 records are 16 bytes so four records at a time are transposed
+	so that each 32-bit lane holds the same four bytes of a different record, then the fields are pulled out of
+	all four lanes at once.  WH3080 records are 20 bytes (and carry light and UV) so they go one at a time.
+*/
+template <class MODEL>
+void usb_weather_history::decode(uint32_t first, const uint8_t *raw, uint32_t count)
+{
+uint32_t current = 0;
+
+has_solar = MODEL::HAS_SOLAR;
+if (!MODEL::HAS_SOLAR)
+	{
+	memset(light + first, 0, count * sizeof(*light));
+	memset(uv + first, 0, count * sizeof(*uv));
+	}
+
+#ifdef USB_WEATHER_SSE2
+	__m128i r0, r1, r2, r3, t0, t1, t2, t3, c0, c1, c2, c3, status, flags;
+	const __m128i byte = _mm_set1_epi32(0xFF), word = _mm_set1_epi32(0xFFFF), nibble = _mm_set1_epi32(0x0F), one = _mm_set1_epi32(1);
+	uint8_t bits[16];
+
+	for (; MODEL::RECORD_SIZE == 16 && current + 4 <= count; current += 4)
+		{
+		/*
+			c0 holds bytes 0-3 of each record, c1 bytes 4-7, c2 bytes 8-11, and c3 bytes 12-15
+		*/
+		r0 = _mm_loadu_si128((const __m128i *)(raw + current * 16));
+		r1 = _mm_loadu_si128((const __m128i *)(raw + current * 16 + 16));
+		r2 = _mm_loadu_si128((const __m128i *)(raw + current * 16 + 32));
+		r3 = _mm_loadu_si128((const __m128i *)(raw + current * 16 + 48));
+		t0 = _mm_unpacklo_epi32(r0, r1);
+		t1 = _mm_unpacklo_epi32(r2, r3);
+		t2 = _mm_unpackhi_epi32(r0, r1);
+		t3 = _mm_unpackhi_epi32(r2, r3);
+		c0 = _mm_unpacklo_epi64(t0, t1);
+		c1 = _mm_unpackhi_epi64(t0, t1);
+		c2 = _mm_unpacklo_epi64(t2, t3);
+		c3 = _mm_unpackhi_epi64(t2, t3);
+
+		_mm_storeu_si128((__m128i *)(delay + first + current), _mm_and_si128(c0, byte));
+		store_doubles(indoor_humidity + first + current, _mm_and_si128(_mm_srli_epi32(c0, 8), byte), 0, 0);
+		store_doubles(indoor_temperature + first + current, sign_magnitude(_mm_srli_epi32(c0, 16)), 10.0, 0);
+		store_doubles(outdoor_humidity + first + current, _mm_and_si128(c1, byte), 0, 0);
+		store_doubles(outdoor_temperature + first + current, sign_magnitude(_mm_srli_epi32(c1, 8)), 10.0, 0);
+		store_doubles(absolute_pressure + first + current, _mm_or_si128(_mm_srli_epi32(c1, 24), _mm_slli_epi32(_mm_and_si128(c2, byte), 8)), 10.0, 0);
+		store_doubles(average_windspeed + first + current, _mm_or_si128(_mm_and_si128(_mm_srli_epi32(c2, 8), byte), _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(c2, 24), nibble), 8)), 10.0, 0);
+		store_doubles(gust_windspeed + first + current, _mm_or_si128(_mm_and_si128(_mm_srli_epi32(c2, 16), byte), _mm_slli_epi32(_mm_srli_epi32(c2, 28), 8)), 10.0, 0);
+		store_doubles(wind_direction + first + current, _mm_and_si128(c3, byte), 0, 22.5);
+		store_doubles(total_rain + first + current, _mm_and_si128(_mm_srli_epi32(c3, 8), word), 0, 0.3);
+
+		/*
+			Status bits down to bytes: the rain counter overflow flags then the lost communications flags
+		*/
+		status = _mm_srli_epi32(c3, 24);
+		flags = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(status, 7), one), _mm_and_si128(_mm_srli_epi32(status, 6), one));
+		_mm_storeu_si128((__m128i *)bits, _mm_packus_epi16(flags, flags));
+		memcpy(rain_counter_overflow + first + current, bits, 4);
+		memcpy(lost_communications + first + current, bits + 4, 4);
+		}
+#elif defined(USB_WEATHER_NEON)
+	uint32x4x4_t column;
+	uint32x4_t byte = vdupq_n_u32(0xFF), word = vdupq_n_u32(0xFFFF), nibble = vdupq_n_u32(0x0F), magnitude = vdupq_n_u32(0x7FFF);
+	uint32_t fields[10][4], lane;
+	int32x4_t negative;
+
+	for (; MODEL::RECORD_SIZE == 16 && current + 4 <= count; current += 4)
+		{
+		/*
+			vld4 transposes as it loads: column.val[0] holds bytes 0-3 of each record, val[1] bytes 4-7, and so on
+		*/
+		column = vld4q_u32((const uint32_t *)(raw + current * 16));
+
+		vst1q_u32(fields[0], vandq_u32(column.val[0], byte));
+		vst1q_u32(fields[1], vandq_u32(vshrq_n_u32(column.val[0], 8), byte));
+		negative = vshrq_n_s32(vreinterpretq_s32_u32(column.val[0]), 31);
+		vst1q_u32(fields[2], vreinterpretq_u32_s32(vsubq_s32(veorq_s32(vreinterpretq_s32_u32(vandq_u32(vshrq_n_u32(column.val[0], 16), magnitude)), negative), negative)));
+		vst1q_u32(fields[3], vandq_u32(column.val[1], byte));
+		negative = vshrq_n_s32(vreinterpretq_s32_u32(vshlq_n_u32(column.val[1], 8)), 31);
+		vst1q_u32(fields[4], vreinterpretq_u32_s32(vsubq_s32(veorq_s32(vreinterpretq_s32_u32(vandq_u32(vshrq_n_u32(column.val[1], 8), magnitude)), negative), negative)));
+		vst1q_u32(fields[5], vorrq_u32(vshrq_n_u32(column.val[1], 24), vshlq_n_u32(vandq_u32(column.val[2], byte), 8)));
+		vst1q_u32(fields[6], vorrq_u32(vandq_u32(vshrq_n_u32(column.val[2], 8), byte), vshlq_n_u32(vandq_u32(vshrq_n_u32(column.val[2], 24), nibble), 8)));
+		vst1q_u32(fields[7], vorrq_u32(vandq_u32(vshrq_n_u32(column.val[2], 16), byte), vshlq_n_u32(vshrq_n_u32(column.val[2], 28), 8)));
+		vst1q_u32(fields[8], vandq_u32(column.val[3], byte));
+		vst1q_u32(fields[9], vandq_u32(vshrq_n_u32(column.val[3], 8), word));
+
+		/*
+		ARMv7 has no double precision SIMD so the conversion is done a lane at a time
+		*/
+		for (lane = 0; lane < 4; lane++)
+			set(first + current + lane, fields[0][lane], fields[1][lane], (int32_t)fields[2][lane], fields[3][lane], (int32_t)fields[4][lane], fields[5][lane], fields[6][lane], fields[7][lane], fields[8][lane], fields[9][lane], raw[(current + lane) * 16 + 15]);
+		}
+#endif
+
+/*
+	Whatever is left over (or everything if we have no SIMD)
+*/
+for (; current < count; current++)
+	{
+	const uint8_t *record = raw + current * MODEL::RECORD_SIZE;
+
+	set(first + current, record[0], record[1], sign_magnitude(record[2] | (record[3] << 8)), record[4], sign_magnitude(record[5] | (record[6] << 8)),
+		record[7] | (record[8] << 8), record[9] | ((record[11] & 0x0F) << 8), record[10] | ((record[11] >> 4) << 8), record[12], record[13] | (record[14] << 8), record[15]);
+	if (MODEL::HAS_SOLAR)
+		{
+		light[first + current] = (record[16] | (record[17] << 8) | (record[18] << 16)) / 10.0;
+		uv[first + current] = record[19];
+		}
+	}
+}
+
+/*
+	The models there are
+*/
+template void usb_weather_history::decode<usb_weather_model_1080>(uint32_t first, const uint8_t *raw, uint32_t count);
+template void usb_weather_history::decode<usb_weather_model_3080>(uint32_t first, const uint8_t *raw, uint32_t count);
+
+/*
+	USB_WEATHER_HISTORY::GET()
+	--------------------------
+	Copy reading which out into a usb_weather_reading
+*/
+void usb_weather_history::get(uint32_t which, usb_weather_reading *into)
+{
+into->delay = delay[which];
+into->indoor_humidity = indoor_humidity[which];
+into->indoor_temperature = indoor_temperature[which];
+into->outdoor_humidity = outdoor_humidity[which];
+into->outdoor_temperature = outdoor_temperature[which];
+into->absolute_pressure = absolute_pressure[which];
+into->average_windspeed = average_windspeed[which];
+into->gust_windspeed = gust_windspeed[which];
+into->wind_direction = wind_direction[which];
+into->total_rain = total_rain[which];
+into->rain_counter_overflow = rain_counter_overflow[which];
+into->lost_communications = lost_communications[which];
+into->light = light[which];
+into->uv = uv[which];
+into->has_solar = has_solar;
+}
@@ -0,0 +1,57 @@
+/*
+	USB_WEATHER_HISTORY.H
+	---------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#ifndef USB_WEATHER_HISTORY_H_
+#define USB_WEATHER_HISTORY_H_
+
+#include "fundamental_types.h"
+#include "usb_weather_reading.h"
+#include "usb_weather_reading_raw.h"
+
+/*
+	class USB_WEATHER_HISTORY
+	-------------------------
+	A run of readings (oldest first) with each field in its own array so that drawing a graph of one field is a
+	walk down one array.  All the arrays are in one allocation.
+*/
+class usb_weather_history
+{
+private:
+	uint8_t *memory;
+	uint32_t capacity;
+
+public:
+	uint32_t readings;					// number of readings held
+	uint8_t has_solar;					// true if light and uv came from the station
+
+	uint32_t *delay;					// minutes since last recording
+	double *indoor_humidity;			// percent
+	double *indoor_temperature;			// degrees C
+	double *outdoor_humidity;			// percent
+	double *outdoor_temperature;		// degrees C
+	double *absolute_pressure;			// hPa
+	double *average_windspeed;			// m/s
+	double *gust_windspeed;				// m/s
+	double *wind_direction;				// degrees from north
+	double *total_rain;					// mm
+	uint8_t *rain_counter_overflow;		// true or false
+	uint8_t *lost_communications;		// true or false
+	double *light;						// lux (0 unless the station is a WH3080)
+	uint8_t *uv;						// UV index (0 unless the station is a WH3080)
+
+private:
+	void set(uint32_t which, uint32_t delay, uint32_t indoor_humidity, int32_t indoor_temperature, uint32_t outdoor_humidity, int32_t outdoor_temperature, uint32_t pressure, uint32_t average, uint32_t gust, uint32_t direction, uint32_t rain, uint32_t status);
+
+public:
+	usb_weather_history();
+	virtual ~usb_weather_history();
+
+	void resize(uint32_t readings);
+	template <class MODEL> void decode(uint32_t first, const uint8_t *raw, uint32_t count);
+	void get(uint32_t which, usb_weather_reading *into);
+} ;
+
+#endif /* USB_WEATHER_HISTORY_H_ */
@@ -0,0 +1,96 @@
+/*
+	USB_WEATHER_HOTPLUG.C
+	---------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+	#include <sys/inotify.h>
+#endif
+#include "usb_weather_hotplug.h"
+
+#ifndef USB_WEATHER_DEV
+	#define USB_WEATHER_DEV "/dev"
+#endif
+
+/*
+	USB_WEATHER_HOTPLUG::USB_WEATHER_HOTPLUG()
+	------------------------------------------
+*/
+usb_weather_hotplug::usb_weather_hotplug()
+{
+watcher = -1;
+}
+
+/*
+	USB_WEATHER_HOTPLUG::~USB_WEATHER_HOTPLUG()
+	-------------------------------------------
+*/
+usb_weather_hotplug::~usb_weather_hotplug()
+{
+if (watcher >= 0)
+	close(watcher);
+}
+
+/*
+	USB_WEATHER_HOTPLUG::WATCH()
+	----------------------------
+	Start watching.  Return an error code (or 0 for success)
+*/
+uint32_t usb_weather_hotplug::watch(void)
+{
+#ifdef __linux__
+	if (watcher >= 0)
+		return 0;
+
+	if ((watcher = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0)
+		return 1;		// can't watch anything
+
+	if (inotify_add_watch(watcher, USB_WEATHER_DEV, IN_CREATE | IN_DELETE | IN_ATTRIB) < 0)
+		{
+		close(watcher);
+		watcher = -1;
+		return 2;		// can't watch the devices
+		}
+
+	return 0;
+#else
+	return 1;			// not supported
+#endif
+}
+
+/*
+	USB_WEATHER_HOTPLUG::CHANGED()
+	------------------------------
+	Read everything that has happened since we last looked and return ADDED if a hidraw device has appeared (or
+	has had its permissions set, which udev does just after it appears) and REMOVED if device_path has gone
+*/
+long usb_weather_hotplug::changed(const char *device_path)
+{
+long changes = 0;
+#ifdef __linux__
+	char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *event;
+	const char *name;
+	ssize_t got;
+	char *at;
+
+	name = strrchr(device_path, '/') == NULL ? device_path : strrchr(device_path, '/') + 1;
+	while ((got = read(watcher, buffer, sizeof(buffer))) > 0)
+		for (at = buffer; at < buffer + got; at += sizeof(struct inotify_event) + event->len)
+			{
+			event = (const struct inotify_event *)at;
+			if (event->len == 0 || strncmp(event->name, "hidraw", 6) != 0)
+				continue;
+
+			if (event->mask & (IN_CREATE | IN_ATTRIB))
+				changes |= ADDED;
+			if ((event->mask & IN_DELETE) && *name != '\0' && strcmp(event->name, name) == 0)
+				changes |= REMOVED;
+			}
+#endif
+
+return changes;
+}
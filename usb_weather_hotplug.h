@@ -0,0 +1,36 @@
+/*
+	USB_WEATHER_HOTPLUG.H
+	---------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#ifndef USB_WEATHER_HOTPLUG_H_
+#define USB_WEATHER_HOTPLUG_H_
+
+#include "fundamental_types.h"
+
+/*
+	class USB_WEATHER_HOTPLUG
+	-------------------------
+	Watch for hidraw devices coming and going (on Linux, by way of inotify on /dev).  The file descriptor can be
+	poll()ed, and when it's readable changed() says what happened.
+*/
+class usb_weather_hotplug
+{
+public:
+	static const long ADDED = 1;				// a hidraw device has appeared
+	static const long REMOVED = 2;				// the device we're watching has gone
+
+private:
+	int watcher;
+
+public:
+	usb_weather_hotplug();
+	virtual ~usb_weather_hotplug();
+
+	uint32_t watch(void);
+	int get_fd(void) { return watcher; }
+	long changed(const char *device_path);
+} ;
+
+#endif /* USB_WEATHER_HOTPLUG_H_ */
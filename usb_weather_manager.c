@@ -0,0 +1,204 @@
+/*
+	USB_WEATHER_MANAGER.C
+	---------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#include <stdio.h>
+#include "usb_weather_manager.h"
+
+/*
+	USB_WEATHER_MANAGER::USB_WEATHER_MANAGER()
+	------------------------------------------
+*/
+usb_weather_manager::usb_weather_manager(uint32_t poll_period_in_seconds, uint32_t model)
+{
+stations = 0;
+poll_period = poll_period_in_seconds;
+this->model = model;
+}
+
+/*
+	USB_WEATHER_MANAGER::~USB_WEATHER_MANAGER()
+	-------------------------------------------
+*/
+usb_weather_manager::~usb_weather_manager()
+{
+long current;
+
+for (current = 0; current < stations; current++)
+	{
+	delete station[current].server;
+	delete station[current].cache;
+	delete station[current].source;
+	}
+}
+
+/*
+	USB_WEATHER_MANAGER::STATION_NAME()
+	-----------------------------------
+	The name of the cache file (or socket) of station which, given the name of station 0's
+*/
+void usb_weather_manager::station_name(char *into, size_t length, const char *name, long which)
+{
+if (which == 0)
+	snprintf(into, length, "%s", name);
+else
+	snprintf(into, length, "%s.%ld", name, which);
+}
+
+/*
+	USB_WEATHER_MANAGER::ADD()
+	--------------------------
+	Take on a station that has been connected to (and its source, which can be NULL).  Returns 0 on success.
+*/
+uint32_t usb_weather_manager::add(usb_weather_cache *cache, usb_weather *source)
+{
+if (stations >= MAX_STATIONS)
+	return 5;		// too many stations
+
+station[stations].cache = cache;
+station[stations].source = source;
+station[stations].server = new usb_weather_server(cache, poll_period);
+stations++;
+
+return 0;
+}
+
+/*
+	USB_WEATHER_MANAGER::ADD()
+	--------------------------
+	Take on some other station (such as a usb_weather_simulator) that has already been connected to.  The
+	manager deletes it when done.  Return an error code (or 0 for success).
+*/
+uint32_t usb_weather_manager::add(usb_weather *source, const char *cache_name)
+{
+usb_weather_cache *cache;
+char filename[1024];
+uint32_t error;
+
+if (stations >= MAX_STATIONS)
+	return 5;		// too many stations
+
+cache = new usb_weather_cache;
+cache->set_model(model);
+station_name(filename, sizeof(filename), cache_name, stations);
+cache->attach(filename);			// if we can't keep the cache in a file then we do without
+
+if ((error = cache->connect(source)) != 0 || (error = add(cache, source)) != 0)
+	{
+	delete cache;
+	return error;
+	}
+
+return 0;
+}
+
+/*
+	USB_WEATHER_MANAGER::DISCOVER()
+	-------------------------------
+	Connect to every attached station with the given VID and PID.  Stations that are there but can't be used
+	(because another process has them, or they won't answer) are skipped.  Return 0 if we found at least one
+	station, otherwise the error code (as for usb_weather::connect()) from the first.
+*/
+uint32_t usb_weather_manager::discover(uint32_t vid, uint32_t pid, const char *cache_name)
+{
+usb_weather_cache *cache;
+char filename[1024];
+uint32_t which, error, first_error = 0;
+
+for (which = 0; stations < MAX_STATIONS; which++)
+	{
+	cache = new usb_weather_cache;
+	cache->set_model(model);
+	station_name(filename, sizeof(filename), cache_name, stations);
+	cache->attach(filename);			// if we can't keep the cache in a file then we do without
+
+	if ((error = cache->connect(vid, pid, which)) == 0)
+		error = add(cache, NULL);
+
+	if (error != 0)
+		{
+		delete cache;
+		if (first_error == 0)
+			first_error = error;
+		if (error == 1 || error == 2)
+			break;			// there are no more stations
+		}
+	}
+
+return stations == 0 ? first_error : 0;
+}
+
+/*
+	USB_WEATHER_MANAGER::LISTEN()
+	-----------------------------
+	Listen for the clients of each station.  Return an error code (or 0 for success), as for usb_weather_server::listen()
+*/
+uint32_t usb_weather_manager::listen(const char *socket_name)
+{
+char filename[1024];
+uint32_t error;
+long current;
+
+for (current = 0; current < stations; current++)
+	{
+	station_name(filename, sizeof(filename), socket_name, current);
+	if ((error = station[current].server->listen(filename)) != 0)
+		return error;
+	}
+
+return 0;
+}
+
+/*
+	USB_WEATHER_MANAGER::SHARE()
+	----------------------------
+	Publish each station in shared memory.  Return an error code (or 0 for success), as for usb_weather_server::share()
+*/
+uint32_t usb_weather_manager::share(const char *shared_name)
+{
+char filename[1024];
+uint32_t error;
+long current;
+
+for (current = 0; current < stations; current++)
+	{
+	station_name(filename, sizeof(filename), shared_name, current);
+	if ((error = station[current].server->share(filename)) != 0)
+		return error;
+	}
+
+return 0;
+}
+
+/*
+	USB_WEATHER_MANAGER::ACQUIRE()
+	------------------------------
+	The thread that looks after one station
+*/
+void *usb_weather_manager::acquire(void *server)
+{
+((usb_weather_server *)server)->run();
+
+return NULL;
+}
+
+/*
+	USB_WEATHER_MANAGER::RUN()
+	--------------------------
+	Serve each station on its own thread, forever.  Returns non-zero if we can't start the threads.
+*/
+uint32_t usb_weather_manager::run(void)
+{
+long current, started;
+
+for (started = 0; started < stations; started++)
+	if (pthread_create(&station[started].thread, NULL, acquire, station[started].server) != 0)
+		break;
+
+for (current = 0; current < started; current++)
+	pthread_join(station[current].thread, NULL);
+
+return started == stations ? 0 : 1;
+}
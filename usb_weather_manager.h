@@ -0,0 +1,67 @@
+/*
+	USB_WEATHER_MANAGER.H
+	---------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#ifndef USB_WEATHER_MANAGER_H_
+#define USB_WEATHER_MANAGER_H_
+
+#include <stddef.h>
+#include <pthread.h>
+#include "usb_weather.h"
+#include "usb_weather_cache.h"
+#include "usb_weather_server.h"
+
+/*
+	class USB_WEATHER_MANAGER_STATION
+	---------------------------------
+	One of the stations the manager looks after
+*/
+class usb_weather_manager_station
+{
+public:
+	usb_weather_cache *cache;				// the station (through its own cache)
+	usb_weather *source;					// what the cache is layered over (NULL for the USB)
+	usb_weather_server *server;				// polls the station and answers its clients
+	pthread_t thread;						// the server runs on this
+} ;
+
+/*
+	class USB_WEATHER_MANAGER
+	-------------------------
+	Look after every attached station.  Each station has its own cache file, its own socket, its own shared
+	memory segment, and its own thread so that a station that is slow to answer (or has stopped answering) holds
+	up nobody else.  Station 0 uses the names it is given, station n uses the names with ".n" on the end.
+*/
+class usb_weather_manager
+{
+private:
+	static const long MAX_STATIONS = 16;
+
+private:
+	usb_weather_manager_station station[MAX_STATIONS];
+	long stations;
+	uint32_t poll_period;					// the longest we go between polls of each station (in seconds)
+	uint32_t model;							// 1080 or 3080
+
+private:
+	static void *acquire(void *server);
+	uint32_t add(usb_weather_cache *cache, usb_weather *source);
+
+public:
+	usb_weather_manager(uint32_t poll_period_in_seconds = 384, uint32_t model = 1080);
+	virtual ~usb_weather_manager();
+
+	static void station_name(char *into, size_t length, const char *name, long which);
+
+	uint32_t discover(uint32_t vid, uint32_t pid, const char *cache_name = USB_WEATHER_CACHE_FILE);
+	uint32_t add(usb_weather *source, const char *cache_name = USB_WEATHER_CACHE_FILE);
+	uint32_t listen(const char *socket_name = USB_WEATHER_SERVER_SOCKET);
+	uint32_t share(const char *shared_name = USB_WEATHER_SHARED_NAME);
+	uint32_t run(void);
+
+	long get_stations(void) { return stations; }
+} ;
+
+#endif /* USB_WEATHER_MANAGER_H_ */
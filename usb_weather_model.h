@@ -0,0 +1,190 @@
+/*
+	USB_WEATHER_MODEL.H
+	-------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#ifndef USB_WEATHER_MODEL_H_
+#define USB_WEATHER_MODEL_H_
+
+#include <iterator>
+#include "fundamental_types.h"
+
+/*
+	class USB_WEATHER_MODEL_1080
+	----------------------------
+	The history ring of a WH1080 (and its clones): 16-byte readings from 0x100 to 0xFFF0
+*/
+class usb_weather_model_1080
+{
+public:
+	static const uint32_t MODEL = 1080;
+	static const uint32_t RECORD_SIZE = 16;						// bytes per reading
+	static const uint32_t FIRST_RECORD = 0x100;					// address of the first reading in the ring
+	static const uint32_t LAST_RECORD = 0x10000 - 16;			// address of the last reading in the ring
+	static const uint32_t SLOTS = (LAST_RECORD - FIRST_RECORD) / RECORD_SIZE + 1;	// number of readings in the ring
+	static const long HAS_SOLAR = false;						// no light or UV sensors
+} ;
+
+/*
+	class USB_WEATHER_MODEL_3080
+	----------------------------
+	The history ring of a WH3080: 20-byte readings (the WH1080 reading then light and UV) from 0x100 to 65516
+*/
+class usb_weather_model_3080
+{
+public:
+	static const uint32_t MODEL = 3080;
+	static const uint32_t RECORD_SIZE = 20;
+	static const uint32_t FIRST_RECORD = 0x100;
+	static const uint32_t LAST_RECORD = 0x10000 - 20;
+	static const uint32_t SLOTS = (LAST_RECORD - FIRST_RECORD) / RECORD_SIZE + 1;
+	static const long HAS_SOLAR = true;
+} ;
+
+template <class MODEL> class usb_weather_ring_iterator;
+
+/*
+	class USB_WEATHER_RING
+	----------------------
+	Walk the history ring of the given model
+*/
+template <class MODEL>
+class usb_weather_ring
+{
+public:
+	static uint16_t next(uint16_t address);
+	static uint16_t previous(uint16_t address);
+	static uint16_t ago(uint16_t current, uint32_t readings_ago);
+	static uint16_t offset(uint16_t address, int32_t readings);
+	static uint32_t distance(uint16_t from, uint16_t to);
+
+	static usb_weather_ring_iterator<MODEL> begin(uint16_t current, uint32_t readings);
+	static usb_weather_ring_iterator<MODEL> end(uint16_t current);
+} ;
+
+/*
+	class USB_WEATHER_RING_ITERATOR
+	-------------------------------
+	A random access iterator over the addresses of the readings in the history ring (*it is the address of a
+	reading).  It counts readings from where it started rather than keeping the address, so going off the end
+	of the ring brings it back round to the start, and two iterators with the same start can be compared and
+	subtracted (which is what the standard algorithms need).  Walk backwards in time with std::reverse_iterator.
+*/
+template <class MODEL>
+class usb_weather_ring_iterator
+{
+public:
+	typedef std::random_access_iterator_tag iterator_category;
+	typedef uint16_t value_type;
+	typedef int32_t difference_type;
+	typedef const uint16_t *pointer;
+	typedef uint16_t reference;
+
+private:
+	uint16_t start;						// the address we count from
+	int32_t readings;					// how many readings on from start we are (negative for before it)
+
+public:
+	usb_weather_ring_iterator() : start(MODEL::FIRST_RECORD), readings(0) {}
+	explicit usb_weather_ring_iterator(uint16_t address, int32_t readings = 0) : start(address), readings(readings) {}
+
+	uint16_t operator*(void) const { return usb_weather_ring<MODEL>::offset(start, readings); }
+	uint16_t operator[](int32_t n) const { return usb_weather_ring<MODEL>::offset(start, readings + n); }
+
+	usb_weather_ring_iterator &operator++(void) { readings++; return *this; }
+	usb_weather_ring_iterator &operator--(void) { readings--; return *this; }
+	usb_weather_ring_iterator operator++(int) { usb_weather_ring_iterator was = *this; readings++; return was; }
+	usb_weather_ring_iterator operator--(int) { usb_weather_ring_iterator was = *this; readings--; return was; }
+	usb_weather_ring_iterator &operator+=(int32_t n) { readings += n; return *this; }
+	usb_weather_ring_iterator &operator-=(int32_t n) { readings -= n; return *this; }
+	usb_weather_ring_iterator operator+(int32_t n) const { return usb_weather_ring_iterator(start, readings + n); }
+	usb_weather_ring_iterator operator-(int32_t n) const { return usb_weather_ring_iterator(start, readings - n); }
+	int32_t operator-(const usb_weather_ring_iterator &with) const { return readings - with.readings; }
+
+	bool operator==(const usb_weather_ring_iterator &with) const { return readings == with.readings; }
+	bool operator!=(const usb_weather_ring_iterator &with) const { return readings != with.readings; }
+	bool operator<(const usb_weather_ring_iterator &with) const { return readings < with.readings; }
+	bool operator>(const usb_weather_ring_iterator &with) const { return readings > with.readings; }
+	bool operator<=(const usb_weather_ring_iterator &with) const { return readings <= with.readings; }
+	bool operator>=(const usb_weather_ring_iterator &with) const { return readings >= with.readings; }
+} ;
+
+/*
+	USB_WEATHER_RING::NEXT()
+	------------------------
+	The reading after the one at address
+*/
+template <class MODEL>
+inline uint16_t usb_weather_ring<MODEL>::next(uint16_t address)
+{
+return address >= MODEL::LAST_RECORD ? MODEL::FIRST_RECORD : address + MODEL::RECORD_SIZE;
+}
+
+/*
+	USB_WEATHER_RING::PREVIOUS()
+	----------------------------
+	The reading before the one at address
+*/
+template <class MODEL>
+inline uint16_t usb_weather_ring<MODEL>::previous(uint16_t address)
+{
+return address <= MODEL::FIRST_RECORD ? MODEL::LAST_RECORD : address - MODEL::RECORD_SIZE;
+}
+
+/*
+	USB_WEATHER_RING::AGO()
+	-----------------------
+	The reading taken readings_ago readings before the one at current
+*/
+template <class MODEL>
+inline uint16_t usb_weather_ring<MODEL>::ago(uint16_t current, uint32_t readings_ago)
+{
+return MODEL::FIRST_RECORD + (((current - MODEL::FIRST_RECORD) / MODEL::RECORD_SIZE + MODEL::SLOTS - readings_ago % MODEL::SLOTS) % MODEL::SLOTS) * MODEL::RECORD_SIZE;
+}
+
+/*
+	USB_WEATHER_RING::OFFSET()
+	--------------------------
+	The reading the given number of readings after (or before, if negative) the one at address
+*/
+template <class MODEL>
+inline uint16_t usb_weather_ring<MODEL>::offset(uint16_t address, int32_t readings)
+{
+return MODEL::FIRST_RECORD + (((int32_t)((address - MODEL::FIRST_RECORD) / MODEL::RECORD_SIZE) + readings % (int32_t)MODEL::SLOTS + (int32_t)MODEL::SLOTS) % (int32_t)MODEL::SLOTS) * MODEL::RECORD_SIZE;
+}
+
+/*
+	USB_WEATHER_RING::DISTANCE()
+	----------------------------
+	The number of readings from the one at from forward to the one at to
+*/
+template <class MODEL>
+inline uint32_t usb_weather_ring<MODEL>::distance(uint16_t from, uint16_t to)
+{
+return (((int32_t)to - (int32_t)from) / (int32_t)MODEL::RECORD_SIZE + (int32_t)MODEL::SLOTS) % MODEL::SLOTS;
+}
+
+/*
+	USB_WEATHER_RING::BEGIN()
+	-------------------------
+	The oldest of the most recent readings readings (the last of which is the one at current)
+*/
+template <class MODEL>
+inline usb_weather_ring_iterator<MODEL> usb_weather_ring<MODEL>::begin(uint16_t current, uint32_t readings)
+{
+return usb_weather_ring_iterator<MODEL>(current, 1 - (int32_t)readings);
+}
+
+/*
+	USB_WEATHER_RING::END()
+	-----------------------
+	One past the reading at current (use with begin())
+*/
+template <class MODEL>
+inline usb_weather_ring_iterator<MODEL> usb_weather_ring<MODEL>::end(uint16_t current)
+{
+return usb_weather_ring_iterator<MODEL>(current, 1);
+}
+
+#endif /* USB_WEATHER_MODEL_H_ */
@@ -28,6 +28,11 @@ if (!lost_communications)
 	printf("Gust windspeed           :%0.2fm/s\n", gust_windspeed);
 	printf("Wind direction           :%0.2f degrees from North\n", wind_direction);
 	printf("Total Rain               :%0.2fmm\n", total_rain);
+	if (has_solar)
+		{
+		printf("Light                    :%0.1f lux\n", light);
+		printf("UV index                 :%d\n", uv);
+		}
 	}
 
 if (rain_counter_overflow)
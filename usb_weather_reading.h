@@ -35,6 +35,9 @@ public:
 	double total_rain;					// mm
 	uint8_t rain_counter_overflow;		// true or false
 	uint8_t lost_communications;		// true or false
+	double light;						// lux (WH3080 only)
+	uint8_t uv;							// UV index (WH3080 only)
+	uint8_t has_solar;					// true if light and uv were read from the station
 
 public:
 	void text_render(const char *title = "");
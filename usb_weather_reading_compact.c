@@ -0,0 +1,83 @@
+/*
+	USB_WEATHER_READING_COMPACT.C
+	-----------------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#include <math.h>
+#include "usb_weather_reading_compact.h"
+
+/*
+	NEAREST()
+	---------
+*/
+static inline long nearest(double value)
+{
+return (long)floor(value + 0.5);
+}
+
+/*
+	USB_WEATHER_READING_COMPACT::DECODE()
+	-------------------------------------
+	Take a 16-byte record from the station (regardless of our byte order)
+*/
+void usb_weather_reading_compact::decode(const uint8_t *raw)
+{
+uint16_t temperature;
+
+delay = raw[0];
+indoor_humidity = raw[1];
+temperature = raw[2] | (raw[3] << 8);
+indoor_temperature = temperature < 0x8000 ? temperature : -(temperature - 0x8000);
+outdoor_humidity = raw[4];
+temperature = raw[5] | (raw[6] << 8);
+outdoor_temperature = temperature < 0x8000 ? temperature : -(temperature - 0x8000);
+absolute_pressure = raw[7] | (raw[8] << 8);
+average_windspeed = raw[9] | ((raw[11] & 0x0F) << 8);
+gust_windspeed = raw[10] | ((raw[11] >> 4) << 8);
+direction_and_status = (raw[12] & 0x0F) | (raw[15] & 0xC0);
+rain_counter = raw[13] | (raw[14] << 8);
+}
+
+/*
+	USB_WEATHER_READING_COMPACT::COMPRESS()
+	---------------------------------------
+	Take a reading that has already been converted into human usable units (and round it to the station's resolution)
+*/
+void usb_weather_reading_compact::compress(const usb_weather_reading *reading)
+{
+delay = reading->delay > 0xFF ? 0xFF : (uint8_t)reading->delay;
+indoor_humidity = (uint8_t)nearest(reading->indoor_humidity);
+indoor_temperature = (int16_t)nearest(reading->indoor_temperature * 10.0);
+outdoor_humidity = (uint8_t)nearest(reading->outdoor_humidity);
+outdoor_temperature = (int16_t)nearest(reading->outdoor_temperature * 10.0);
+absolute_pressure = (uint16_t)nearest(reading->absolute_pressure * 10.0);
+average_windspeed = (uint16_t)nearest(reading->average_windspeed * 10.0);
+gust_windspeed = (uint16_t)nearest(reading->gust_windspeed * 10.0);
+direction_and_status = (uint8_t)(nearest(reading->wind_direction / 22.5) & 0x0F);
+direction_and_status |= (reading->rain_counter_overflow ? 0x80 : 0) | (reading->lost_communications ? 0x40 : 0);
+rain_counter = (uint16_t)nearest(reading->total_rain / 0.3);
+}
+
+/*
+	USB_WEATHER_READING_COMPACT::EXPAND()
+	-------------------------------------
+*/
+void usb_weather_reading_compact::expand(usb_weather_reading *into) const
+{
+into->delay = delay;
+into->indoor_humidity = indoor_humidity;
+into->indoor_temperature = get_indoor_temperature();
+into->outdoor_humidity = outdoor_humidity;
+into->outdoor_temperature = get_outdoor_temperature();
+into->absolute_pressure = get_absolute_pressure();
+into->average_windspeed = get_average_windspeed();
+into->gust_windspeed = get_gust_windspeed();
+into->wind_direction = get_wind_direction();
+into->total_rain = get_total_rain();
+into->rain_counter_overflow = get_rain_counter_overflow();
+into->lost_communications = get_lost_communications();
+into->light = 0;
+into->uv = 0;
+into->has_solar = false;
+}
@@ -0,0 +1,50 @@
+/*
+	USB_WEATHER_READING_COMPACT.H
+	-----------------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#ifndef USB_WEATHER_READING_COMPACT_H_
+#define USB_WEATHER_READING_COMPACT_H_
+
+#include "fundamental_types.h"
+#include "usb_weather_reading.h"
+
+/*
+	class USB_WEATHER_READING_COMPACT
+	---------------------------------
+	A reading in 16 bytes (without the WH3080's light and UV) (rather than the 90-odd of a usb_weather_reading).  The values are kept at the
+	resolution of the station (tenths of a degree, tenths of a hPa, tenths of a m/s, and tips of the rain guage)
+	and are only turned into doubles when asked for.
+*/
+class usb_weather_reading_compact
+{
+public:
+	int16_t indoor_temperature;			// tenths of a degree C
+	int16_t outdoor_temperature;		// tenths of a degree C
+	uint16_t absolute_pressure;			// tenths of a hPa
+	uint16_t average_windspeed;			// tenths of a m/s
+	uint16_t gust_windspeed;			// tenths of a m/s
+	uint16_t rain_counter;				// tips of the rain guage (0.3mm each)
+	uint8_t delay;						// minutes since last recording
+	uint8_t indoor_humidity;			// percent
+	uint8_t outdoor_humidity;			// percent
+	uint8_t direction_and_status;		// low 4 bits are the wind direction (in 22.5 degree steps), bits 6 and 7 are the same as the station's status
+
+public:
+	void decode(const uint8_t *raw);
+	void compress(const usb_weather_reading *reading);
+	void expand(usb_weather_reading *into) const;
+
+	double get_indoor_temperature(void) const { return indoor_temperature / 10.0; }
+	double get_outdoor_temperature(void) const { return outdoor_temperature / 10.0; }
+	double get_absolute_pressure(void) const { return absolute_pressure / 10.0; }
+	double get_average_windspeed(void) const { return average_windspeed / 10.0; }
+	double get_gust_windspeed(void) const { return gust_windspeed / 10.0; }
+	double get_wind_direction(void) const { return (direction_and_status & 0x0F) * 22.5; }
+	double get_total_rain(void) const { return rain_counter * 0.3; }
+	uint8_t get_rain_counter_overflow(void) const { return (direction_and_status >> 7) & 1; }
+	uint8_t get_lost_communications(void) const { return (direction_and_status >> 6) & 1; }
+} ;
+
+#endif /* USB_WEATHER_READING_COMPACT_H_ */
@@ -0,0 +1,156 @@
+/*
+	USB_WEATHER_SCHEDULER.C
+	-----------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#include <math.h>
+#include "usb_weather_scheduler.h"
+#include "usb_weather_statistics.h"
+
+const double usb_weather_scheduler::MARGIN = 1.0;
+const double usb_weather_scheduler::MIN_WIDTH = 2.0;
+const double usb_weather_scheduler::DRIFT = 0.25;
+
+/*
+	USB_WEATHER_SCHEDULER::USB_WEATHER_SCHEDULER()
+	----------------------------------------------
+*/
+usb_weather_scheduler::usb_weather_scheduler(double max_interval_in_seconds, double period_in_seconds)
+{
+period = period_in_seconds;
+max_interval = max_interval_in_seconds < period ? period : max_interval_in_seconds;
+forget();
+}
+
+/*
+	USB_WEATHER_SCHEDULER::FORGET()
+	-------------------------------
+	Start learning again (because the station has been unplugged, for example)
+*/
+void usb_weather_scheduler::forget(void)
+{
+last_poll = last_change = -1;
+earliest = latest = 0;
+known = false;
+misses = 0;
+cycles = 1;
+}
+
+/*
+	USB_WEATHER_SCHEDULER::NOW()
+	----------------------------
+	Seconds since some time in the past (that doesn't jump when the clock is set)
+*/
+double usb_weather_scheduler::now(void)
+{
+return usb_weather_statistics::now_in_us() / 1000000.0;
+}
+
+/*
+	USB_WEATHER_SCHEDULER::AFTER()
+	------------------------------
+	The time to poll for the first write expected after when (that we haven't already seen)
+*/
+double usb_weather_scheduler::after(double when)
+{
+double expected;
+
+expected = latest + MARGIN;
+expected += (floor((when - expected) / period) + 1) * period;
+if (last_change > expected - MARGIN - (latest - earliest))
+	expected += period;
+
+return expected;
+}
+
+/*
+	USB_WEATHER_SCHEDULER::OBSERVE()
+	--------------------------------
+	We polled the station at when and either did or did not see a change since the last poll
+*/
+void usb_weather_scheduler::observe(double when, long changed)
+{
+double from, to, cycles_on;
+
+/*
+	Move what we know about the writes on to the cycle we're in now (allowing for drift)
+*/
+if (known)
+	{
+	cycles_on = floor((when - latest) / period + 0.5);
+	earliest += cycles_on * period - fabs(cycles_on) * DRIFT;
+	latest += cycles_on * period + fabs(cycles_on) * DRIFT;
+	}
+
+if (changed)
+	{
+	/*
+		There was a write between the last poll and this one.  If that's less than a cycle then it's something
+		to go on, and if we already had some idea then narrow it down (unless the two don't agree, in which case
+		the station has drifted and we go with what we've just seen).
+	*/
+	if (last_poll >= 0 && when - last_poll < period)
+		{
+		from = known && earliest > last_poll ? earliest : last_poll;
+		to = known && latest < when ? latest : when;
+		if (!known || from >= to)
+			{
+			from = last_poll;
+			to = when;
+			}
+		earliest = from < to - MIN_WIDTH ? from : to - MIN_WIDTH;
+		latest = to;
+		known = true;
+		}
+	misses = 0;
+	cycles = 1;
+	last_change = when;
+	}
+else if (known && misses == 0 && when < latest)
+	earliest = when > earliest ? when : earliest;			// looking half way through: the write is still to come
+else if (++misses > MAX_MISSES && cycles * period < max_interval)
+	cycles *= 2;
+
+last_poll = when;
+}
+
+/*
+	USB_WEATHER_SCHEDULER::NEXT_POLL()
+	----------------------------------
+	When (in the same terms as now()) to poll next
+*/
+double usb_weather_scheduler::next_poll(void)
+{
+double interval, middle;
+
+if (last_poll < 0)
+	return 0;					// never polled, so now
+
+if (misses > MAX_MISSES)
+	{
+	/*
+		Nothing is changing (or the station isn't answering) so back off, but still poll just after a write
+	*/
+	interval = cycles * period < max_interval ? cycles * period : max_interval;
+	return known ? after(last_poll + interval - period) : last_poll + interval;
+	}
+
+if (!known)
+	return last_poll + period / 4;			// still learning
+
+if (misses > 0 && misses <= MAX_LATE)
+	return last_poll + period / 16;			// the write is late
+
+if (latest - earliest > 2 * MIN_WIDTH)
+	{
+	middle = (earliest + latest) / 2;
+	middle += (floor((last_poll - middle) / period) + 1) * period;
+	if (last_change > middle - (latest - earliest) / 2)
+		middle += period;
+	if (middle < after(last_poll))
+		return middle;
+	}
+
+return after(last_poll);
+}
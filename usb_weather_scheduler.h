@@ -0,0 +1,60 @@
+/*
+	USB_WEATHER_SCHEDULER.H
+	-----------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#ifndef USB_WEATHER_SCHEDULER_H_
+#define USB_WEATHER_SCHEDULER_H_
+
+#include "fundamental_types.h"
+
+/*
+	class USB_WEATHER_SCHEDULER
+	---------------------------
+	Decide when to poll the station.  The station re-writes the current reading every 48 seconds or so (and moves
+	on to the next reading every read_period minutes, also on one of those writes), so there is no point in polling
+	more often than that, and the best time to poll is just after a write.  We learn when the writes happen from
+	when we see changes: a change seen now that wasn't there at the last poll means a write since the last poll.
+	Until we know, we poll every quarter cycle.  Once we know, we poll just after each write.  The station's clock
+	isn't exact so we allow for it drifting a little each cycle, and whenever that leaves us unsure by more than
+	a few seconds we also look half way between when the write could first have happened and when it must have
+	happened, which narrows it down again.  If a write doesn't turn up when expected we look again a couple of
+	times shortly after.  If nothing changes for several cycles (the weather is steady or the station isn't
+	answering) we back off, doubling the gap each time, to no less often than max_interval.  The first change we
+	see puts us back to polling every cycle.
+*/
+class usb_weather_scheduler
+{
+private:
+	static const long MAX_LATE = 2;				// times to look again for a write that is late
+	static const long MAX_MISSES = 8;			// polls without a change before backing off
+	static const double MARGIN;					// seconds after the expected write to poll
+	static const double MIN_WIDTH;				// the least we'll narrow earliest to latest down to
+	static const double DRIFT;					// seconds the station's writes might move each cycle
+
+private:
+	double period;								// seconds between the station's writes
+	double max_interval;						// the longest we wait between polls
+	double last_poll;							// when we last polled (negative if never)
+	double last_change;							// when we last saw a change
+	double earliest, latest;					// a write happened after earliest and no later than latest
+	long known;									// true once earliest and latest are less than a cycle apart
+	long misses;								// polls since the last change
+	uint32_t cycles;							// when backed off, the number of cycles between polls
+
+private:
+	double after(double when);
+
+public:
+	usb_weather_scheduler(double max_interval_in_seconds = 384, double period_in_seconds = 48);
+	virtual ~usb_weather_scheduler() {}
+
+	static double now(void);
+
+	void observe(double when, long changed);
+	double next_poll(void);
+	void forget(void);
+} ;
+
+#endif /* USB_WEATHER_SCHEDULER_H_ */
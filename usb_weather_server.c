@@ -0,0 +1,323 @@
+/*
+	USB_WEATHER_SERVER.C
+	--------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "usb_weather_server.h"
+
+/*
+	USB_WEATHER_SERVER::USB_WEATHER_SERVER()
+	----------------------------------------
+*/
+usb_weather_server::usb_weather_server(usb_weather_cache *station, uint32_t longest_poll_in_seconds) : scheduler(longest_poll_in_seconds)
+{
+this->station = station;
+socket_name = NULL;
+memset(current_reading, 0, sizeof(current_reading));
+connections = 0;
+filling = true;
+lost = false;
+sharing = false;
+}
+
+/*
+	USB_WEATHER_SERVER::~USB_WEATHER_SERVER()
+	-----------------------------------------
+*/
+usb_weather_server::~usb_weather_server()
+{
+while (connections > FIRST_CLIENT)
+	close_client(connections - 1);
+
+if (connections > 0)
+	close(connection[0].fd);
+
+if (socket_name != NULL)
+	{
+	unlink(socket_name);
+	free(socket_name);
+	}
+}
+
+/*
+	USB_WEATHER_SERVER::LISTEN()
+	----------------------------
+	Return an error code (or 0 for success)
+*/
+uint32_t usb_weather_server::listen(const char *socket_name)
+{
+struct sockaddr_un address;
+mode_t mask;
+int file, bound;
+
+if (strlen(socket_name) >= sizeof(address.sun_path))
+	return 1;		// name too long
+
+usb_weather::make_directory_for(socket_name);
+
+if ((file = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+	return 1;		// can't create a socket
+
+memset(&address, 0, sizeof(address));
+address.sun_family = AF_UNIX;
+strcpy(address.sun_path, socket_name);
+
+/*
+	Remove any socket left over from a previous run.  serve_weather is run by the web server (as a different user)
+	so anyone may connect, and the socket is made that way (rather than chmod()ed after, which would follow
+	whatever someone put at the name in the meantime).
+*/
+unlink(socket_name);
+mask = umask(0111);
+bound = bind(file, (struct sockaddr *)&address, sizeof(address));
+umask(mask);
+if (bound != 0)
+	{
+	close(file);
+	return 2;		// can't bind to the name
+	}
+
+if (::listen(file, 16) != 0)
+	{
+	close(file);
+	unlink(socket_name);
+	return 3;		// can't listen
+	}
+
+fcntl(file, F_SETFL, fcntl(file, F_GETFL) | O_NONBLOCK);
+connection[0].fd = file;
+connection[0].events = POLLIN;
+
+/*
+	Watch for the station being unplugged and plugged back in (poll() ignores the watcher if we can't have one)
+*/
+connection[1].fd = hotplug.watch() == 0 ? hotplug.get_fd() : -1;
+connection[1].events = POLLIN;
+connection[1].revents = 0;
+
+connections = FIRST_CLIENT;
+this->socket_name = strdup(socket_name);
+
+return 0;
+}
+
+/*
+	USB_WEATHER_SERVER::SHARE()
+	---------------------------
+	Publish the cache in the named shared memory segment.  Return an error code (or 0 for success), as for
+	usb_weather_shared::attach()
+*/
+uint32_t usb_weather_server::share(const char *shared_name)
+{
+uint32_t error;
+
+if ((error = shared.attach(shared_name)) == 0)
+	sharing = true;
+
+return error;
+}
+
+/*
+	USB_WEATHER_SERVER::PUBLISH()
+	-----------------------------
+*/
+void usb_weather_server::publish(void)
+{
+if (sharing)
+	shared.publish(station);
+}
+
+/*
+	USB_WEATHER_SERVER::ACCEPT_CLIENT()
+	-----------------------------------
+*/
+void usb_weather_server::accept_client(void)
+{
+int file;
+
+while ((file = accept(connection[0].fd, NULL, NULL)) >= 0)
+	{
+	if (connections >= MAX_CLIENTS + FIRST_CLIENT)
+		{
+		close(file);		// too busy
+		continue;
+		}
+	fcntl(file, F_SETFL, fcntl(file, F_GETFL) | O_NONBLOCK);
+	connection[connections].fd = file;
+	connection[connections].events = POLLIN;
+	connection[connections].revents = 0;
+	request_length[connections] = 0;
+	connections++;
+	}
+}
+
+/*
+	USB_WEATHER_SERVER::CLOSE_CLIENT()
+	----------------------------------
+	Hang up on the client and move the last client into its slot
+*/
+void usb_weather_server::close_client(long which)
+{
+close(connection[which].fd);
+
+connections--;
+connection[which] = connection[connections];
+request[which] = request[connections];
+request_length[which] = request_length[connections];
+}
+
+/*
+	USB_WEATHER_SERVER::SERVE_CLIENT()
+	----------------------------------
+	Returns false if the client has gone away (or is sending garbage)
+*/
+long usb_weather_server::serve_client(long which)
+{
+usb_weather_server_reply reply;
+uint16_t address;
+ssize_t got;
+
+if ((got = recv(connection[which].fd, (uint8_t *)&request[which] + request_length[which], sizeof(request[which]) - request_length[which], 0)) <= 0)
+	return got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+
+if ((request_length[which] += got) < sizeof(request[which]))
+	return true;		// wait for the rest of it
+
+request_length[which] = 0;
+if (request[which].report_id != 0xA1)
+	return false;
+
+/*
+	Answer the request out of the cache (or from the station if we don't have it)
+*/
+address = (request[which].address_high << 8) | request[which].address_low;
+reply.status = (uint8_t)station->read(address, reply.data);
+
+return send(connection[which].fd, &reply, sizeof(reply), MSG_NOSIGNAL) == sizeof(reply);
+}
+
+/*
+	USB_WEATHER_SERVER::POLL_STATION()
+	----------------------------------
+	The station re-writes the current reading every 48 seconds or so and moves on to the next reading
+	every read_period minutes.  Fetch whatever has changed since we last looked, and the current reading (so
+	that it's fresh and so that the scheduler can see when it changes).  Returns 0 on success.
+*/
+uint32_t usb_weather_server::poll_station(void)
+{
+usb_weather_fixed_block_1080 *block;
+uint8_t reading[32];
+long got, changed;
+
+if ((got = station->sync()) < 0 || (block = station->read_fixed_block()) == NULL || station->read_raw_readings(block->current_position, 1, reading) != 1)
+	{
+	lost = true;		// try reconnecting next time
+	scheduler.observe(usb_weather_scheduler::now(), false);
+	return 1;
+	}
+
+changed = got > 0 || memcmp(reading, current_reading, station->get_record_size()) != 0;
+memcpy(current_reading, reading, sizeof(current_reading));
+scheduler.observe(usb_weather_scheduler::now(), changed);
+
+if (got > 0)
+	filling = true;		// in case the history was reset (in which case the cache needs filling again)
+
+publish();
+
+return 0;
+}
+
+/*
+	USB_WEATHER_SERVER::RECONNECT_STATION()
+	---------------------------------------
+	The station has gone away (or stopped answering), so let go of it and try to get it back
+*/
+void usb_weather_server::reconnect_station(void)
+{
+if (station->reconnect() == 0)
+	{
+	lost = false;
+	scheduler.forget();
+	poll_station();
+	}
+else
+	scheduler.observe(usb_weather_scheduler::now(), false);
+}
+
+/*
+	USB_WEATHER_SERVER::RUN()
+	-------------------------
+	Serve clients forever.  The cache reads ahead of anyone scanning through the history on a thread of its own,
+	so we hold the cache's lock whenever we're not waiting.
+*/
+void usb_weather_server::run(void)
+{
+double now, next;
+long current, timeout, changes, ready;
+
+station->start_prefetching();
+station->lock();
+for (;;)
+	{
+	if ((now = usb_weather_scheduler::now()) >= scheduler.next_poll())
+		{
+		if (lost)
+			reconnect_station();
+		else
+			poll_station();
+		now = usb_weather_scheduler::now();
+		}
+
+	/*
+		While the cache is missing some of the history, fetch it a little at a time whenever we're not busy
+	*/
+	next = scheduler.next_poll();
+	timeout = filling || next <= now ? 0 : (long)((next - now) * 1000) + 1;
+	station->unlock();
+	ready = poll(connection, connections, timeout);
+	station->lock();
+	if (ready <= 0)
+		{
+		if (filling)
+			{
+			filling = station->fill(8) != 0;
+			publish();
+			}
+		continue;
+		}
+
+	/*
+		Has the station been unplugged or plugged back in?
+	*/
+	if (connection[1].revents & POLLIN)
+		{
+		changes = hotplug.changed(station->get_device_path());
+		if (changes & usb_weather_hotplug::REMOVED)
+			lost = true;
+		if ((changes & usb_weather_hotplug::ADDED) && lost)
+			reconnect_station();
+		}
+
+	/*
+		Service the existing clients before accepting new ones (as accepting re-orders the list)
+	*/
+	for (current = connections - 1; current >= FIRST_CLIENT; current--)
+		if (connection[current].revents & (POLLIN | POLLHUP | POLLERR))
+			if (!serve_client(current))
+				close_client(current);
+
+	if (connection[0].revents & POLLIN)
+		accept_client();
+	}
+}
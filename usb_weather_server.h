@@ -0,0 +1,82 @@
+/*
+	USB_WEATHER_SERVER.H
+	--------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#ifndef USB_WEATHER_SERVER_H_
+#define USB_WEATHER_SERVER_H_
+
+#include <poll.h>
+#include "usb_weather_cache.h"
+#include "usb_weather_hotplug.h"
+#include "usb_weather_message.h"
+#include "usb_weather_scheduler.h"
+#include "usb_weather_shared.h"
+
+/*
+	Where the daemon listens for its clients (somewhere only root can make it, as the clients trust what's there)
+*/
+#define USB_WEATHER_SERVER_SOCKET USB_WEATHER_RUN_DIRECTORY "/usb_weather.socket"
+
+/*
+	class USB_WEATHER_SERVER_REPLY
+	------------------------------
+	A client sends the daemon a usb_weather_message (exactly as it would to the station) and gets one of these back
+*/
+#pragma pack(1)
+class usb_weather_server_reply
+{
+public:
+	uint8_t status;						// number of valid bytes in data (32 on success, 0 on failure)
+	uint8_t data[32];
+} ;
+#pragma pack()
+
+/*
+	class USB_WEATHER_SERVER
+	------------------------
+	Own the weather station (and hold its lock) for as long as we run, poll it just after it writes, and answer
+	read requests from clients (serve_weather) out of the cache over a local socket.  If asked to share() then
+	after each poll we also publish the cache in shared memory, where clients can read it without asking us.  If
+	the station is unplugged we reconnect when it is plugged back in.
+*/
+class usb_weather_server
+{
+private:
+	static const long MAX_CLIENTS = 64;
+	static const long FIRST_CLIENT = 2;				// connection[0] is the listening socket, [1] the hotplug watcher
+
+private:
+	usb_weather_cache *station;
+	char *socket_name;
+	usb_weather_scheduler scheduler;					// when to poll the station
+	uint8_t current_reading[32];						// what the current reading was when we last polled
+	long filling;										// true while we're fetching history the cache doesn't have
+	long lost;											// true if the station has gone away (or stopped answering)
+	usb_weather_hotplug hotplug;
+	struct pollfd connection[MAX_CLIENTS + FIRST_CLIENT];
+	usb_weather_message request[MAX_CLIENTS + FIRST_CLIENT];		// partially recieved requests
+	uint32_t request_length[MAX_CLIENTS + FIRST_CLIENT];			// bytes of each request recieved so far
+	long connections;
+	usb_weather_shared shared;							// where we publish the cache
+	long sharing;										// true if we publish the cache
+
+private:
+	void accept_client(void);
+	long serve_client(long which);
+	void close_client(long which);
+	void reconnect_station(void);
+	void publish(void);
+
+public:
+	usb_weather_server(usb_weather_cache *station, uint32_t longest_poll_in_seconds = 384);
+	virtual ~usb_weather_server();
+
+	uint32_t listen(const char *socket_name = USB_WEATHER_SERVER_SOCKET);
+	uint32_t share(const char *shared_name = USB_WEATHER_SHARED_NAME);
+	uint32_t poll_station(void);
+	void run(void);
+} ;
+
+#endif /* USB_WEATHER_SERVER_H_ */
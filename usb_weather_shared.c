@@ -0,0 +1,248 @@
+/*
+	USB_WEATHER_SHARED.C
+	--------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "usb_weather_shared.h"
+
+/*
+	USB_WEATHER_SHARED::USB_WEATHER_SHARED()
+	----------------------------------------
+*/
+usb_weather_shared::usb_weather_shared()
+{
+image = NULL;
+fallback = NULL;
+fallback_context = NULL;
+source = NULL;
+asked_fallback = false;
+pending_hit = false;
+}
+
+/*
+	USB_WEATHER_SHARED::~USB_WEATHER_SHARED()
+	-----------------------------------------
+	The fallback's station is the caller's to delete
+*/
+usb_weather_shared::~usb_weather_shared()
+{
+if (image != NULL)
+	munmap(image, sizeof(*image));
+}
+
+/*
+	USB_WEATHER_SHARED::ATTACH()
+	----------------------------
+	Map the segment (creating it if nobody has yet).  Return an error code (or 0 for success).
+*/
+uint32_t usb_weather_shared::attach(const char *name)
+{
+usb_weather_shared_image *segment;
+int file;
+
+if ((file = shm_open(name, O_RDWR | O_CREAT, 0600)) < 0)
+	return 1;		// can't open the segment
+
+/*
+	Whoever gets here first makes it the right size (it starts out all 0, which is "nothing published")
+*/
+if (ftruncate(file, sizeof(*segment)) != 0)
+	{
+	close(file);
+	return 2;		// can't make it the right size
+	}
+
+segment = (usb_weather_shared_image *)mmap(NULL, sizeof(*segment), PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+close(file);
+if (segment == MAP_FAILED)
+	return 3;		// can't map it
+
+if (image != NULL)
+	munmap(image, sizeof(*image));
+image = segment;
+
+return 0;
+}
+
+/*
+	USB_WEATHER_SHARED::CONNECT()
+	-----------------------------
+	Use what has been published (for the model we've been set to).  Anything that isn't there is asked of
+	whatever fallback(context) returns.  Return an error code (or 0 for success), as for usb_weather::connect():
+	2 if nothing has been published or what was is too old.
+*/
+uint32_t usb_weather_shared::connect(usb_weather_shared_fallback fallback, void *context)
+{
+if (image == NULL)
+	return 1;		// not attached
+
+if (image->magic != usb_weather_shared_image::MAGIC || image->version != usb_weather_shared_image::VERSION || image->model != get_model() || (uint32_t)time(NULL) >= image->expires)
+	return 2;
+
+/*
+	The fixed block must come from the segment (or it's not worth using)
+*/
+this->fallback = NULL;
+if (reload_fixed_block() == NULL)
+	return 3;
+
+this->fallback = fallback;
+fallback_context = context;
+source = NULL;
+asked_fallback = false;
+
+return 0;
+}
+
+/*
+	USB_WEATHER_SHARED::COPY()
+	--------------------------
+	Copy the 32 bytes at address out of the segment (what's past the end of memory comes back as 0).  Returns
+	true if we have all of them.
+*/
+long usb_weather_shared::copy(uint16_t address, void *result)
+{
+uint32_t start, end, at, length;
+long tries, complete;
+
+end = (uint32_t)address + 32 > 0x10000 ? 0x10000 : (uint32_t)address + 32;
+length = end - address;
+
+for (tries = 0; tries < MAX_TRIES; tries++)
+	{
+	if ((start = image->sequence) & 1)
+		{
+		sched_yield();			// the writer is part way through
+		continue;
+		}
+	__sync_synchronize();
+
+	memcpy(result, image->memory_map + address, length);
+	complete = true;
+	for (at = address; at < end && complete; at++)
+		complete = (image->have[at / usb_weather_cache_image::LINE_SIZE] >> (at % usb_weather_cache_image::LINE_SIZE)) & 1;
+
+	__sync_synchronize();
+	if (image->sequence == start)
+		{
+		memset((uint8_t *)result + length, 0, 32 - length);
+		return complete;
+		}
+	}
+
+return false;
+}
+
+/*
+	USB_WEATHER_SHARED::REQUEST()
+	-----------------------------
+*/
+long usb_weather_shared::request(uint16_t address)
+{
+if (image != NULL && (pending_hit = copy(address, pending)))
+	return true;
+
+if (!asked_fallback && fallback != NULL)
+	{
+	asked_fallback = true;
+	source = fallback(fallback_context);
+	}
+
+return source == NULL ? false : source->request(address);
+}
+
+/*
+	USB_WEATHER_SHARED::RECEIVE()
+	-----------------------------
+*/
+uint32_t usb_weather_shared::receive(void *result)
+{
+if (pending_hit)
+	{
+	pending_hit = false;
+	memcpy(result, pending, sizeof(pending));
+	return sizeof(pending);
+	}
+
+return source == NULL ? 0 : source->receive(result);
+}
+
+/*
+	USB_WEATHER_SHARED::READ_CURRENT_READINGS()
+	-------------------------------------------
+	The current reading has already been decoded by the writer, so take that
+*/
+usb_weather_reading *usb_weather_shared::read_current_readings(void)
+{
+usb_weather_reading *answer;
+uint32_t start;
+long tries, has_current;
+
+answer = new usb_weather_reading;
+for (tries = 0; image != NULL && tries < MAX_TRIES; tries++)
+	{
+	if ((start = image->sequence) & 1)
+		{
+		sched_yield();
+		continue;
+		}
+	__sync_synchronize();
+
+	has_current = image->has_current;
+	*answer = image->current;
+
+	__sync_synchronize();
+	if (image->sequence == start)
+		{
+		if (has_current)
+			return answer;
+		break;
+		}
+	}
+
+delete answer;
+return usb_weather::read_current_readings();
+}
+
+/*
+	USB_WEATHER_SHARED::PUBLISH()
+	-----------------------------
+	Put what from knows into the segment.  Only the process that owns the station (holds its lock) may do this,
+	so there's only ever one writer.  Return an error code (or 0 for success).
+*/
+uint32_t usb_weather_shared::publish(usb_weather_cache *from)
+{
+usb_weather_reading *current;
+
+if (image == NULL)
+	return 1;		// not attached
+
+current = from->read_current_readings();			// before we start, as this might have to go to the station
+
+/*
+	If a writer died part way through then sequence is already odd, and it's even again once we're done
+*/
+image->sequence |= 1;
+__sync_synchronize();
+
+image->magic = usb_weather_shared_image::MAGIC;
+image->version = usb_weather_shared_image::VERSION;
+image->model = from->get_model();
+image->expires = from->snapshot(image->memory_map, image->have);
+if ((image->has_current = current != NULL))
+	image->current = *current;
+
+__sync_synchronize();
+image->sequence++;
+
+delete current;
+
+return 0;
+}
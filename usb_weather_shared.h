@@ -0,0 +1,88 @@
+/*
+	USB_WEATHER_SHARED.H
+	--------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#ifndef USB_WEATHER_SHARED_H_
+#define USB_WEATHER_SHARED_H_
+
+#include "usb_weather.h"
+#include "usb_weather_cache.h"
+
+/*
+	The name of the POSIX shared memory segment the station is published in
+*/
+#define USB_WEATHER_SHARED_NAME "/usb_weather"
+
+/*
+	USB_WEATHER_SHARED_FALLBACK
+	---------------------------
+	Called (once) by usb_weather_shared the first time it's asked for something that isn't in the segment.
+	Returns what to ask instead (or NULL if there's nothing).
+*/
+typedef usb_weather *(*usb_weather_shared_fallback)(void *context);
+
+/*
+	class USB_WEATHER_SHARED_IMAGE
+	------------------------------
+	What's in the segment: a snapshot of a usb_weather_cache (laid out the same way) and the current reading
+	already decoded.  The one process that owns the station writes it under a seqlock: sequence is odd while
+	it's part way through, so a reader that sees sequence change (or odd) while copying has to copy again.
+*/
+class usb_weather_shared_image
+{
+public:
+	static const uint32_t MAGIC = 0x57483153;		// "WH1S"
+	static const uint32_t VERSION = 1;
+
+public:
+	uint32_t magic;
+	uint32_t version;
+	volatile uint32_t sequence;
+	uint32_t model;							// 1080 or 3080
+	uint32_t expires;						// when (as for time()) the snapshot stops being good (0 if there isn't one)
+	uint32_t has_current;					// true if current is the decoded current reading
+	usb_weather_reading current;
+	uint8_t memory_map[0x10000];
+	uint16_t have[usb_weather_cache_image::LINES];
+} ;
+
+/*
+	class USB_WEATHER_SHARED
+	------------------------
+	Publish what the owner of the station knows in shared memory, and read it back in every other process
+	without going near the USB or the station's lock.  Anything that isn't in the segment is asked of the
+	fallback instead.
+*/
+class usb_weather_shared : public usb_weather
+{
+private:
+	static const long MAX_TRIES = 1000;			// copies to try before deciding the writer has died part way through
+
+private:
+	usb_weather_shared_image *image;
+	usb_weather_shared_fallback fallback;
+	void *fallback_context;
+	usb_weather *source;						// what the fallback gave us (NULL if we haven't needed it)
+	long asked_fallback;						// true once we've called the fallback
+	uint8_t pending[32];						// the answer to the last request() (if pending_hit)
+	long pending_hit;							// true if the last request() was answered from the segment
+
+private:
+	long copy(uint16_t address, void *result);
+
+public:
+	usb_weather_shared();
+	virtual ~usb_weather_shared();
+
+	uint32_t attach(const char *name = USB_WEATHER_SHARED_NAME);
+	uint32_t connect(usb_weather_shared_fallback fallback = NULL, void *context = NULL);
+	uint32_t publish(usb_weather_cache *from);
+
+	virtual long request(uint16_t address);
+	virtual uint32_t receive(void *result);
+	virtual usb_weather_reading *read_current_readings(void);
+} ;
+
+#endif /* USB_WEATHER_SHARED_H_ */
@@ -0,0 +1,418 @@
+/*
+	USB_WEATHER_SIMULATOR.C
+	-----------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "usb_weather_simulator.h"
+#include "usb_weather_datetime.h"
+#include "usb_weather_message.h"
+
+/*
+	PUT_UINT16()
+	------------
+	The station is little endian (regardless of what we are)
+*/
+static inline void put_uint16(uint8_t *into, uint16_t value)
+{
+into[0] = value & 0xFF;
+into[1] = (value >> 8) & 0xFF;
+}
+
+/*
+	GET_UINT16()
+	------------
+*/
+static inline uint16_t get_uint16(const uint8_t *from)
+{
+return from[0] | (from[1] << 8);
+}
+
+/*
+	ENCODE_TEMPERATURE()
+	--------------------
+	Temperatures are stored in tenths of a degree as sign and magnitude
+*/
+static inline uint16_t encode_temperature(double temperature)
+{
+long tenths = lround(temperature * 10.0);
+
+return tenths < 0 ? 0x8000 | (uint16_t)-tenths : (uint16_t)tenths;
+}
+
+/*
+	USB_WEATHER_SIMULATOR::USB_WEATHER_SIMULATOR()
+	----------------------------------------------
+*/
+usb_weather_simulator::usb_weather_simulator(uint32_t seed)
+{
+memset(memory, 0, sizeof(memory));
+filename = NULL;
+latency_in_us = 10000;
+failure_rate = 0.0;
+time_scale = 1.0;
+this->seed = seed == 0 ? 1 : seed;
+rain_counter = 0;
+epoch = time(NULL);
+clock_gettime(CLOCK_MONOTONIC, &real_start);
+current_started = last_update = 0;
+pending_address = 0;
+pending_failed = true;
+pending_since = real_start;
+}
+
+/*
+	USB_WEATHER_SIMULATOR::~USB_WEATHER_SIMULATOR()
+	-----------------------------------------------
+*/
+usb_weather_simulator::~usb_weather_simulator()
+{
+if (filename != NULL)
+	{
+	save();
+	free(filename);
+	}
+}
+
+/*
+	USB_WEATHER_SIMULATOR::RANDOM()
+	-------------------------------
+	xorshift32, so that a given seed always makes the same station
+*/
+uint32_t usb_weather_simulator::random(void)
+{
+seed ^= seed << 13;
+seed ^= seed >> 17;
+seed ^= seed << 5;
+
+return seed;
+}
+
+/*
+	USB_WEATHER_SIMULATOR::RANDOM_BETWEEN()
+	---------------------------------------
+*/
+double usb_weather_simulator::random_between(double low, double high)
+{
+return low + (high - low) * (random() / 4294967296.0);
+}
+
+/*
+	USB_WEATHER_SIMULATOR::SIMULATED_TIME()
+	---------------------------------------
+	Seconds since epoch in simulated time
+*/
+double usb_weather_simulator::simulated_time(void)
+{
+struct timespec now;
+
+clock_gettime(CLOCK_MONOTONIC, &now);
+
+return ((now.tv_sec - real_start.tv_sec) + (now.tv_nsec - real_start.tv_nsec) / 1000000000.0) * time_scale;
+}
+
+/*
+	USB_WEATHER_SIMULATOR::ENCODE_READING()
+	---------------------------------------
+	Make up the weather at the given (simulated) time and store it as a reading at address
+*/
+void usb_weather_simulator::encode_reading(uint16_t address, double when, uint32_t delay)
+{
+static const double pi = 3.14159265358979323846;
+double hour, outdoor_temperature, indoor_temperature, outdoor_humidity, indoor_humidity, pressure, average, gust, light;
+uint16_t average_tenths, gust_tenths;
+uint8_t *into = memory + address, status = 0;
+time_t at = epoch + (time_t)floor(when);
+struct tm local;
+
+localtime_r(&at, &local);
+hour = local.tm_hour + local.tm_min / 60.0;
+
+/*
+	A daily temperature cycle peaking mid afternoon, humidity moving the other way, pressure drifting
+	over a few days, and a gusty wind that comes and goes
+*/
+outdoor_temperature = 11.0 + 6.0 * sin(2 * pi * (hour - 9.0) / 24.0) + random_between(-0.3, 0.3);
+indoor_temperature = 19.0 + 1.5 * sin(2 * pi * (hour - 11.0) / 24.0) + random_between(-0.1, 0.1);
+outdoor_humidity = 80.0 - 2.5 * (outdoor_temperature - 11.0) + random_between(-2.0, 2.0);
+outdoor_humidity = outdoor_humidity < 10 ? 10 : outdoor_humidity > 99 ? 99 : outdoor_humidity;
+indoor_humidity = 50.0 + random_between(-2.0, 2.0);
+pressure = 990.0 + 8.0 * sin(2 * pi * when / (3 * 24 * 60 * 60)) + random_between(-0.2, 0.2);
+average = 3.0 + 2.0 * sin(2 * pi * when / (9 * 60 * 60)) + random_between(-1.0, 1.0);
+average = average < 0 ? 0 : average;
+gust = average * random_between(1.2, 1.8);
+average_tenths = (uint16_t)lround(average * 10.0) & 0x0FFF;
+gust_tenths = (uint16_t)lround(gust * 10.0) & 0x0FFF;
+
+/*
+	Every now and then it rains, and every now and then we lose contact with the outdoor sensors
+*/
+if (random() % 50 == 0)
+	rain_counter += 1 + random() % 3;
+if (rain_counter > 0xFFFF)
+	status |= 0x80;				// rain counter overflow
+if (random() % 200 == 0)
+	status |= 0x40;				// lost contact with the sensors
+
+into[0] = delay;
+into[1] = (uint8_t)lround(indoor_humidity);
+put_uint16(into + 2, encode_temperature(indoor_temperature));
+into[4] = (uint8_t)lround(outdoor_humidity);
+put_uint16(into + 5, encode_temperature(outdoor_temperature));
+put_uint16(into + 7, (uint16_t)lround(pressure * 10.0));
+into[9] = average_tenths & 0xFF;
+into[10] = gust_tenths & 0xFF;
+into[11] = ((average_tenths >> 8) & 0x0F) | (((gust_tenths >> 8) & 0x0F) << 4);
+into[12] = (uint8_t)lround(8.0 + 4.0 * sin(when / 20000.0)) % 16;
+put_uint16(into + 13, rain_counter & 0xFFFF);
+into[15] = status;
+
+/*
+	A WH3080 also has light (in tenths of a lux) and UV sensors, the sun is up from 6am to 6pm
+*/
+if (get_model() == 3080)
+	{
+	light = hour < 6 || hour > 18 ? 0 : 800000.0 * sin(pi * (hour - 6.0) / 12.0) * random_between(0.3, 1.0);
+	into[16] = (uint32_t)lround(light) & 0xFF;
+	into[17] = ((uint32_t)lround(light) >> 8) & 0xFF;
+	into[18] = ((uint32_t)lround(light) >> 16) & 0xFF;
+	into[19] = (uint8_t)(light / 80000.0);
+	}
+}
+
+/*
+	USB_WEATHER_SIMULATOR::UPDATE_FIXED_BLOCK()
+	-------------------------------------------
+	The current time and pressures in the fixed block
+*/
+void usb_weather_simulator::update_fixed_block(double when)
+{
+usb_weather_fixed_block_1080 *block = (usb_weather_fixed_block_1080 *)memory;
+time_t at = epoch + (time_t)floor(when);
+uint16_t pressure;
+struct tm local;
+
+localtime_r(&at, &local);
+block->current_time.year = usb_weather_datetime::int_to_bcd(local.tm_year % 100);
+block->current_time.month = usb_weather_datetime::int_to_bcd(local.tm_mon + 1);
+block->current_time.day = usb_weather_datetime::int_to_bcd(local.tm_mday);
+block->current_time.hour = usb_weather_datetime::int_to_bcd(local.tm_hour);
+block->current_time.minute = usb_weather_datetime::int_to_bcd(local.tm_min);
+
+pressure = get_uint16(memory + get_uint16((uint8_t *)&block->current_position) + 7);
+put_uint16((uint8_t *)&block->absolute_pressure, pressure);
+put_uint16((uint8_t *)&block->relative_pressure, pressure + 220);		// about 184m above sea level
+}
+
+/*
+	USB_WEATHER_SIMULATOR::CREATE()
+	-------------------------------
+	Make up a station with a full ring of 5-minute readings
+*/
+void usb_weather_simulator::create(void)
+{
+usb_weather_fixed_block_1080 *block = (usb_weather_fixed_block_1080 *)memory;
+uint32_t ago, slot, position_slot, slots = get_ring_slots(), size = get_record_size();
+
+memset(memory, 0, sizeof(memory));
+put_uint16((uint8_t *)&block->eeprom_init, 0xAA55);
+block->read_period = 5;
+block->unit_settings_1 = 1 << 5;			// hPa
+block->unit_settings_2 = 1 << 0;			// m/s
+block->display_options_1 = (1 << 4) | (1 << 5);
+block->display_options_2 = (1 << 0) | (1 << 4);
+put_uint16((uint8_t *)&block->data_count, slots);
+position_slot = random() % slots;
+put_uint16((uint8_t *)&block->current_position, 0x100 + position_slot * size);
+
+/*
+	Write the history oldest first so that the rain guage only goes up
+*/
+rain_counter = random() % 1000;
+for (ago = slots - 1; ago > 0; ago--)
+	{
+	slot = (position_slot + slots - ago) % slots;
+	encode_reading(0x100 + slot * size, -(double)ago * block->read_period * 60, block->read_period);
+	}
+encode_reading(0x100 + position_slot * size, 0, 0);
+
+current_started = last_update = 0;
+update_fixed_block(0);
+}
+
+/*
+	USB_WEATHER_SIMULATOR::ADVANCE()
+	--------------------------------
+	Do whatever the station would have done between the last time we looked and now
+*/
+void usb_weather_simulator::advance(void)
+{
+usb_weather_fixed_block_1080 *block = (usb_weather_fixed_block_1080 *)memory;
+double now, period;
+uint16_t position, count;
+
+now = simulated_time();
+period = (block->read_period == 0 ? 1 : block->read_period) * 60.0;
+
+/*
+	Move on to the next reading every read_period minutes
+*/
+while (now - current_started >= period)
+	{
+	current_started += period;
+	position = get_uint16((uint8_t *)&block->current_position);
+	encode_reading(position, current_started, block->read_period);
+
+	if ((uint32_t)position + 2 * get_record_size() > 0x10000)
+		position = 0x100;			// wrap around to 0x100
+	else
+		position += get_record_size();
+	count = get_uint16((uint8_t *)&block->data_count);
+	if (count < get_ring_slots())
+		count++;
+
+	put_uint16((uint8_t *)&block->current_position, position);
+	put_uint16((uint8_t *)&block->data_count, count);
+	encode_reading(position, current_started, 0);
+	last_update = current_started;
+	}
+
+/*
+	Re-write the current reading every 48 seconds
+*/
+if (now - last_update >= UPDATE_PERIOD)
+	{
+	last_update += floor((now - last_update) / UPDATE_PERIOD) * UPDATE_PERIOD;
+	position = get_uint16((uint8_t *)&block->current_position);
+	encode_reading(position, last_update, (uint32_t)((last_update - current_started) / 60));
+	}
+
+update_fixed_block(now);
+}
+
+/*
+	USB_WEATHER_SIMULATOR::CONNECT()
+	--------------------------------
+	Load the station's memory from the given file (or make up a new station if we can't).
+	Return an error code (or 0 for success), the codes are the same as for usb_weather::connect()
+*/
+uint32_t usb_weather_simulator::connect(const char *image_filename)
+{
+usb_weather_fixed_block_1080 *block = (usb_weather_fixed_block_1080 *)memory;
+FILE *file;
+uint16_t position;
+long loaded = false;
+
+if ((file = fopen(image_filename, "rb")) != NULL)
+	{
+	loaded = fread(memory, sizeof(memory), 1, file) == 1 && get_uint16((uint8_t *)&block->eeprom_init) == 0xAA55;
+	fclose(file);
+	}
+
+if (loaded)
+	{
+	/*
+		Carry on from where the image left off
+	*/
+	position = get_uint16((uint8_t *)&block->current_position);
+	rain_counter = get_uint16(memory + position + 13);
+	current_started = -(double)memory[position] * 60;
+	last_update = 0;
+	}
+else
+	create();
+
+free(filename);
+filename = strdup(image_filename);
+
+if (read_fixed_block() == NULL)
+	return 3;	// cannot read the fixed block.
+
+return 0;
+}
+
+/*
+	USB_WEATHER_SIMULATOR::SAVE()
+	-----------------------------
+	Write the station's memory back to the image file.  Return an error code (or 0 for success)
+*/
+uint32_t usb_weather_simulator::save(void)
+{
+FILE *file;
+long written;
+
+if (filename == NULL || (file = fopen(filename, "wb")) == NULL)
+	return 1;
+
+written = fwrite(memory, sizeof(memory), 1, file) == 1;
+fclose(file);
+
+return written ? 0 : 2;
+}
+
+/*
+	USB_WEATHER_SIMULATOR::REQUEST()
+	--------------------------------
+	The station takes latency_in_us to answer, starting from now
+*/
+long usb_weather_simulator::request(uint16_t address)
+{
+advance();
+
+pending_address = address;
+pending_failed = random_between(0.0, 1.0) < failure_rate;
+clock_gettime(CLOCK_MONOTONIC, &pending_since);
+
+statistics.usb_writes++;
+statistics.bytes_sent += sizeof(usb_weather_message);
+statistics.write.add(0);
+
+return true;
+}
+
+/*
+	USB_WEATHER_SIMULATOR::RECEIVE()
+	--------------------------------
+	Wait for whatever is left of the latency of the last request() and then answer it
+*/
+uint32_t usb_weather_simulator::receive(void *result)
+{
+uint8_t *into = (uint8_t *)result;
+struct timespec now;
+long long waited;
+uint32_t current;
+uint64_t start = usb_weather_statistics::now_in_us();
+
+if (latency_in_us != 0)
+	{
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	waited = (now.tv_sec - pending_since.tv_sec) * 1000000LL + (now.tv_nsec - pending_since.tv_nsec) / 1000;
+	if (waited < latency_in_us)
+		usleep(latency_in_us - waited);
+	}
+
+/*
+	The whole answer comes in one go (rather than four 8-byte reports)
+*/
+statistics.usb_reads++;
+statistics.read.add(usb_weather_statistics::now_in_us() - start);
+if (pending_failed)
+	{
+	statistics.timeouts++;
+	return 0;
+	}
+statistics.bytes_received += 32;
+
+/*
+	Like the station, addresses wrap at 64K
+*/
+for (current = 0; current < 32; current++)
+	into[current] = memory[(pending_address + current) & 0xFFFF];
+
+return 32;
+}
@@ -0,0 +1,68 @@
+/*
+	USB_WEATHER_SIMULATOR.H
+	-----------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#ifndef USB_WEATHER_SIMULATOR_H_
+#define USB_WEATHER_SIMULATOR_H_
+
+#include <time.h>
+#include "usb_weather.h"
+
+/*
+	class USB_WEATHER_SIMULATOR
+	---------------------------
+	A pretend WH1080 (or WH3080 if set_model(3080) is called before connect()) backed by a 64KB image of its memory (kept in a file).  If the file doesn't exist we make up
+	a station with a full ring of history.  Like the real thing it re-writes the current reading every 48 seconds,
+	moves on to the next reading every read_period minutes, takes a while to answer, and sometimes doesn't.
+*/
+class usb_weather_simulator : public usb_weather
+{
+private:
+	static const uint32_t UPDATE_PERIOD = 48;		// seconds between re-writes of the current reading
+
+private:
+	uint8_t memory[0x10000];
+	char *filename;
+
+	uint32_t latency_in_us;						// how long each transaction takes
+	double failure_rate;						// proportion of transactions that fail (0..1)
+	double time_scale;							// simulated seconds per real second
+
+	time_t epoch;								// wall clock time when we started
+	struct timespec real_start;					// monotonic clock time when we started
+	double current_started;						// simulated seconds (since epoch) when the current reading began
+	double last_update;							// simulated seconds (since epoch) of the last re-write of the current reading
+	uint32_t seed;								// random number generator state
+	uint32_t rain_counter;						// tips of the rain guage (0.3mm each)
+
+	uint16_t pending_address;					// the last request()
+	long pending_failed;						// true if the last request() is not going to be answered
+	struct timespec pending_since;				// monotonic clock time of the last request()
+
+private:
+	uint32_t random(void);
+	double random_between(double low, double high);
+	double simulated_time(void);
+	void encode_reading(uint16_t address, double when, uint32_t delay);
+	void update_fixed_block(double when);
+	void create(void);
+	void advance(void);
+
+public:
+	usb_weather_simulator(uint32_t seed = 1080);
+	virtual ~usb_weather_simulator();
+
+	uint32_t connect(const char *image_filename);
+	uint32_t save(void);
+
+	virtual long request(uint16_t address);
+	virtual uint32_t receive(void *result);
+
+	void set_latency(uint32_t microseconds) { latency_in_us = microseconds; }
+	void set_failure_rate(double rate) { failure_rate = rate; }
+	void set_time_scale(double scale) { time_scale = scale; }
+} ;
+
+#endif /* USB_WEATHER_SIMULATOR_H_ */
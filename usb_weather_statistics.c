@@ -0,0 +1,143 @@
+/*
+	USB_WEATHER_STATISTICS.C
+	------------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#include <string.h>
+#ifdef _MSC_VER
+	#include <Windows.h>
+#else
+	#include <time.h>
+#endif
+#include "usb_weather_statistics.h"
+
+/*
+	USB_WEATHER_HISTOGRAM::CLEAR()
+	------------------------------
+*/
+void usb_weather_histogram::clear(void)
+{
+memset(this, 0, sizeof(*this));
+}
+
+/*
+	USB_WEATHER_HISTOGRAM::ADD()
+	----------------------------
+*/
+void usb_weather_histogram::add(uint64_t microseconds)
+{
+long which = 0;
+
+while (which < BUCKETS - 1 && (microseconds >> (which + 1)) != 0)
+	which++;
+
+bucket[which]++;
+count++;
+total_us += microseconds;
+if (microseconds > max_us)
+	max_us = microseconds;
+}
+
+/*
+	USB_WEATHER_HISTOGRAM::PERCENTILE()
+	-----------------------------------
+	The latency that fraction (0..1) of the calls were no slower than (to the top of the bucket it falls in)
+*/
+uint64_t usb_weather_histogram::percentile(double fraction)
+{
+uint64_t seen = 0, top;
+long which;
+
+for (which = 0; which < BUCKETS; which++)
+	if ((seen += bucket[which]) != 0 && seen >= fraction * count)
+		{
+		top = ((uint64_t)2 << which) - 1;
+		return top < max_us ? top : max_us;
+		}
+
+return max_us;
+}
+
+/*
+	USB_WEATHER_HISTOGRAM::TEXT_RENDER()
+	------------------------------------
+*/
+void usb_weather_histogram::text_render(FILE *into, const char *title)
+{
+long which, width;
+uint64_t most = 0;
+
+fprintf(into, "%s: %llu calls", title, (unsigned long long)count);
+if (count == 0)
+	{
+	fprintf(into, "\n");
+	return;
+	}
+fprintf(into, ", mean %lluus, 50%% %lluus, 99%% %lluus, max %lluus\n", (unsigned long long)(total_us / count), (unsigned long long)percentile(0.5), (unsigned long long)percentile(0.99), (unsigned long long)max_us);
+
+for (which = 0; which < BUCKETS; which++)
+	most = bucket[which] > most ? bucket[which] : most;
+
+for (which = 0; which < BUCKETS; which++)
+	if (bucket[which] != 0)
+		{
+		fprintf(into, "  %10llu-%-10lluus %10llu ", which == 0 ? 0ULL : 1ULL << which, (2ULL << which) - 1, (unsigned long long)bucket[which]);
+		for (width = (long)(40 * bucket[which] / most); width > 0; width--)
+			fputc('*', into);
+		fputc('\n', into);
+		}
+}
+
+/*
+	USB_WEATHER_STATISTICS::NOW_IN_US()
+	-----------------------------------
+	A clock in microseconds (from some arbitrary point)
+*/
+uint64_t usb_weather_statistics::now_in_us(void)
+{
+#ifdef _MSC_VER
+	LARGE_INTEGER now, frequency;
+
+	QueryPerformanceCounter(&now);
+	QueryPerformanceFrequency(&frequency);
+	return (uint64_t)(now.QuadPart * 1000000.0 / frequency.QuadPart);
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#endif
+}
+
+/*
+	USB_WEATHER_STATISTICS::CLEAR()
+	-------------------------------
+*/
+void usb_weather_statistics::clear(void)
+{
+transactions = retries = failures = timeouts = 0;
+usb_writes = usb_reads = bytes_sent = bytes_received = 0;
+transaction.clear();
+write.clear();
+read.clear();
+}
+
+/*
+	USB_WEATHER_STATISTICS::TEXT_RENDER()
+	-------------------------------------
+*/
+void usb_weather_statistics::text_render(FILE *into)
+{
+fprintf(into, "USB WEATHER STATISTICS\n");
+fprintf(into, "----------------------\n");
+fprintf(into, "Transactions             : %llu\n", (unsigned long long)transactions);
+fprintf(into, "Retries                  : %llu\n", (unsigned long long)retries);
+fprintf(into, "Failures                 : %llu\n", (unsigned long long)failures);
+fprintf(into, "Timeouts                 : %llu\n", (unsigned long long)timeouts);
+fprintf(into, "USB writes               : %llu (%llu bytes)\n", (unsigned long long)usb_writes, (unsigned long long)bytes_sent);
+fprintf(into, "USB reads                : %llu (%llu bytes)\n", (unsigned long long)usb_reads, (unsigned long long)bytes_received);
+transaction.text_render(into, "Transaction latency      ");
+write.text_render(into, "USB write latency        ");
+read.text_render(into, "USB read latency         ");
+}
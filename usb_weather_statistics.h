@@ -0,0 +1,67 @@
+/*
+	USB_WEATHER_STATISTICS.H
+	------------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#ifndef USB_WEATHER_STATISTICS_H_
+#define USB_WEATHER_STATISTICS_H_
+
+#include <stdio.h>
+#include "fundamental_types.h"
+
+/*
+	class USB_WEATHER_HISTOGRAM
+	---------------------------
+	Latencies bucketed by powers of two: bucket b holds those of 2^b to 2^(b+1)-1 microseconds (bucket 0 also holds 0)
+*/
+class usb_weather_histogram
+{
+public:
+	static const long BUCKETS = 32;
+
+public:
+	uint64_t count;
+	uint64_t total_us;
+	uint64_t max_us;
+	uint64_t bucket[BUCKETS];
+
+public:
+	void clear(void);
+	void add(uint64_t microseconds);
+	uint64_t percentile(double fraction);
+	void text_render(FILE *into, const char *title);
+} ;
+
+/*
+	class USB_WEATHER_STATISTICS
+	----------------------------
+	What a usb_weather has been doing.  A transaction is the reading of one 32-byte block (however it's done:
+	from the station, the daemon, or the cache) and is timed from request to reply.  The USB writes and reads
+	are the HID reports sent to and recieved from the station itself, each one timed on its own.
+*/
+class usb_weather_statistics
+{
+public:
+	uint64_t transactions;					// 32-byte blocks asked for
+	uint64_t retries;						// transactions that had to be tried again
+	uint64_t failures;						// transactions that failed (even after retrying)
+	uint64_t timeouts;						// USB reads that timed out
+	uint64_t usb_writes;					// HID reports sent to the station
+	uint64_t usb_reads;						// HID reports recieved from the station
+	uint64_t bytes_sent;
+	uint64_t bytes_received;
+	usb_weather_histogram transaction;		// latency of each transaction
+	usb_weather_histogram write;			// latency of each USB write
+	usb_weather_histogram read;				// latency of each USB read
+
+public:
+	usb_weather_statistics() { clear(); }
+
+	static uint64_t now_in_us(void);
+
+	void clear(void);
+	void text_render(FILE *into = stdout);
+} ;
+
+#endif /* USB_WEATHER_STATISTICS_H_ */
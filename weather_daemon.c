@@ -0,0 +1,144 @@
+/*
+	WEATHER_DAEMON.C
+	----------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "usb_weather_cache.h"
+#include "usb_weather_manager.h"
+#include "usb_weather_server.h"
+#include "usb_weather_simulator.h"
+
+/*
+	These are the USB VID and PID of the weather station I've got
+*/
+#define USB_WEATHER_VID 0x1941			// Dream Link (in my case DIGITECH)
+#define USB_WEATHER_PID 0x8021			// WH1080 Weather Station / USB Missile Launcher (in my case USB Wireless Weather Station)
+
+/*
+	HELP()
+	------
+*/
+void help(void)
+{
+puts("COMMAND LINE ARGUMENTS");
+puts("----------------------");
+puts("-?                            : display this message");
+puts("-3080                         : the station is a WH3080 (with light and UV sensors)");
+puts("-cache <filename>             : where to keep the cache between runs [default: " USB_WEATHER_CACHE_FILE "]");
+puts("-foreground                   : don't detach from the terminal");
+puts("-poll <seconds>               : the longest to go between polls when the weather isn't changing [default: 384]");
+puts("-shared <name>                : the shared memory segment to publish the cache in [default: " USB_WEATHER_SHARED_NAME "]");
+puts("-simulate <filename>          : serve a simulated station whose memory is kept in <filename> (repeat for more stations)");
+puts("-socket <filename>            : where to listen for clients [default: " USB_WEATHER_SERVER_SOCKET "]");
+puts("");
+puts("Every attached station is served, each on its own thread.  Station 0 uses the cache, socket, and shared");
+puts("memory names given, station n uses the names with .n on the end.  Each station is polled just after it");
+puts("re-writes its current reading (about every 48 seconds), less often while nothing is changing.");
+puts("");
+}
+
+/*
+	MAIN()
+	------
+*/
+int main(int argc, char *argv[])
+{
+usb_weather_manager *manager;
+usb_weather_simulator *simulator;
+const char *socket_name = USB_WEATHER_SERVER_SOCKET;
+const char *cache_name = USB_WEATHER_CACHE_FILE;
+const char *shared_name = USB_WEATHER_SHARED_NAME;
+const char *simulator_image[16];
+long parameter, simulators = 0, current, foreground = false;
+uint32_t poll_period = 384, model = 1080;
+int error = 0;
+
+for (parameter = 1; parameter < argc; parameter++)
+	{
+	if (strcmp(argv[parameter], "-3080") == 0)
+		model = 3080;
+	else if (strcmp(argv[parameter], "-cache") == 0 && parameter + 1 < argc)
+		cache_name = argv[++parameter];
+	else if (strcmp(argv[parameter], "-foreground") == 0)
+		foreground = true;
+	else if (strcmp(argv[parameter], "-poll") == 0 && parameter + 1 < argc)
+		poll_period = atol(argv[++parameter]);
+	else if (strcmp(argv[parameter], "-shared") == 0 && parameter + 1 < argc)
+		shared_name = argv[++parameter];
+	else if (strcmp(argv[parameter], "-simulate") == 0 && parameter + 1 < argc && simulators < (long)(sizeof(simulator_image) / sizeof(*simulator_image)))
+		simulator_image[simulators++] = argv[++parameter];
+	else if (strcmp(argv[parameter], "-socket") == 0 && parameter + 1 < argc)
+		socket_name = argv[++parameter];
+	else
+		{
+		help();
+		return 0;
+		}
+	}
+
+if (poll_period < 1)
+	poll_period = 1;
+
+/*
+	Find the stations (either simulated or every one on the USB)
+*/
+manager = new usb_weather_manager(poll_period, model);
+if (simulators != 0)
+	for (current = 0; current < simulators && error == 0; current++)
+		{
+		simulator = new usb_weather_simulator;
+		simulator->set_model(model);
+		if ((error = simulator->connect(simulator_image[current])) != 0 || (error = manager->add(simulator, cache_name)) != 0)
+			delete simulator;
+		}
+else
+	error = manager->discover(USB_WEATHER_VID, USB_WEATHER_PID, cache_name);
+
+if (error != 0)
+	{
+	printf("Cannot find an attached weather station, Error:%d\n", error);
+	if (error == 1)
+		puts("Remember to sudo this program");
+	delete manager;
+	return 1;
+	}
+
+if ((error = manager->listen(socket_name)) != 0)
+	{
+	printf("Cannot listen on %s, Error:%d\n", socket_name, error);
+	delete manager;
+	return 1;
+	}
+
+/*
+	Clients can still ask us if we can't publish the cache for them
+*/
+if ((error = manager->share(shared_name)) != 0)
+	printf("Cannot publish the cache in %s, Error:%d\n", shared_name, error);
+
+if (manager->get_stations() > 1)
+	printf("Serving %ld weather stations on %s (and %s.1 onwards)\n", manager->get_stations(), socket_name, socket_name);
+
+/*
+	Clients that hang up mid-reply must not kill us
+*/
+signal(SIGPIPE, SIG_IGN);
+
+if (!foreground)
+	if (daemon(0, 0) != 0)
+		exit(printf("Cannot detach from the terminal\n"));
+
+if (manager->run() != 0)
+	puts("Cannot start a thread for each weather station");
+
+delete manager;
+
+return 0;
+}
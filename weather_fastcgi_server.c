@@ -0,0 +1,311 @@
+/*
+	WEATHER_FASTCGI_SERVER.C
+	------------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#include <string.h>
+#include <sys/socket.h>
+#include "weather_fastcgi_server.h"
+
+/*
+	WEATHER_FASTCGI_SERVER::RECORD()
+	--------------------------------
+	Put a record (padded out to a multiple of 8 bytes, as the specification recommends) on the end of into
+*/
+void weather_fastcgi_server::record(std::string *into, uint8_t type, uint16_t id, const char *content, size_t length)
+{
+uint8_t header[HEADER_LENGTH];
+size_t padding;
+
+padding = (8 - length % 8) % 8;
+
+header[0] = VERSION;
+header[1] = type;
+header[2] = id >> 8;
+header[3] = id & 0xFF;
+header[4] = length >> 8;
+header[5] = length & 0xFF;
+header[6] = padding;
+header[7] = 0;
+
+into->append((char *)header, sizeof(header));
+into->append(content, length);
+into->append(padding, '\0');
+}
+
+/*
+	WEATHER_FASTCGI_SERVER::END_REQUEST()
+	-------------------------------------
+*/
+void weather_fastcgi_server::end_request(std::string *into, uint16_t id, uint8_t status)
+{
+char body[8];
+
+memset(body, 0, sizeof(body));			// an application status of 0
+body[4] = status;
+
+record(into, END_REQUEST, id, body, sizeof(body));
+}
+
+/*
+	WEATHER_FASTCGI_SERVER::PAIR_LENGTH()
+	-------------------------------------
+	Lengths in a name-value pair take 1 byte if they're under 128, otherwise 4 (with the top bit set).  Returns
+	the length, or SIZE_MAX if there isn't one at *at.
+*/
+size_t weather_fastcgi_server::pair_length(const std::string *from, size_t *at)
+{
+const uint8_t *length;
+
+if (*at >= from->size())
+	return SIZE_MAX;
+
+length = (const uint8_t *)from->data() + *at;
+if ((*length & 0x80) == 0)
+	{
+	*at += 1;
+	return *length;
+	}
+
+if (*at + 4 > from->size())
+	return SIZE_MAX;
+
+*at += 4;
+return ((size_t)(length[0] & 0x7F) << 24) | ((size_t)length[1] << 16) | ((size_t)length[2] << 8) | length[3];
+}
+
+/*
+	WEATHER_FASTCGI_SERVER::NEXT_PAIR()
+	-----------------------------------
+	Take the name-value pair at *at (and move past it).  Returns false if there isn't a whole one there.
+*/
+long weather_fastcgi_server::next_pair(const std::string *from, size_t *at, std::string *name, std::string *value)
+{
+size_t name_length, value_length;
+
+if ((name_length = pair_length(from, at)) == SIZE_MAX || (value_length = pair_length(from, at)) == SIZE_MAX)
+	return false;
+if (name_length > from->size() - *at || value_length > from->size() - *at - name_length)
+	return false;
+
+name->assign(*from, *at, name_length);
+value->assign(*from, *at + name_length, value_length);
+*at += name_length + value_length;
+
+return true;
+}
+
+/*
+	WEATHER_FASTCGI_SERVER::ADD_PAIR()
+	----------------------------------
+	Only used for short names and values (under 128 bytes)
+*/
+void weather_fastcgi_server::add_pair(std::string *into, const char *name, const char *value)
+{
+*into += (char)strlen(name);
+*into += (char)strlen(value);
+*into += name;
+*into += value;
+}
+
+/*
+	WEATHER_FASTCGI_SERVER::GET_VALUES()
+	------------------------------------
+	The web server asking what we can do.  All it needs to know is that we'll take several requests at once over
+	one connection (it can work out the rest for itself).
+*/
+void weather_fastcgi_server::get_values(weather_fastcgi_connection *client, const std::string *content)
+{
+std::string result, name, value;
+size_t at;
+
+at = 0;
+while (next_pair(content, &at, &name, &value))
+	if (name == "FCGI_MPXS_CONNS")
+		add_pair(&result, "FCGI_MPXS_CONNS", "1");
+
+record(&client->output, GET_VALUES_RESULT, 0, result.data(), result.size());
+}
+
+/*
+	WEATHER_FASTCGI_SERVER::ANSWER()
+	--------------------------------
+	We've got all of request id (the web server has closed its FCGI_STDIN stream), so answer it
+*/
+void weather_fastcgi_server::answer(weather_fastcgi_connection *client, uint16_t id)
+{
+weather_fastcgi_request *begun;
+weather_http_request request;
+std::string page, name, value;
+size_t at, length;
+
+begun = &client->request[id];
+
+request.clear();
+request.keep_alive = begun->keep_connection;
+at = 0;
+while (next_pair(&begun->params, &at, &name, &value))
+	if (name == "REQUEST_METHOD")
+		request.method = value;
+	else if (name == "SCRIPT_NAME")
+		request.path = value;
+	else if (name == "QUERY_STRING")
+		request.query_string = value;
+	else if (name == "HTTP_USER_AGENT")
+		request.user_agent = value;
+	else if (name == "HTTP_IF_NONE_MATCH")
+		request.if_none_match = value;
+	else if (name == "HTTP_IF_MODIFIED_SINCE")
+		request.if_modified_since = value;
+	else if (name == "HTTP_ACCEPT_ENCODING")
+		request.accept_encoding = value;
+
+handler(context, &request, &page);
+
+/*
+	The page goes back as it is (the web server makes the HTTP reply of it), in as many records as it takes
+	(each a multiple of 8 bytes so they need no padding), then an empty one to end the stream
+*/
+for (at = 0; at < page.size(); at += length)
+	{
+	length = page.size() - at < (MAX_CONTENT & ~7) ? page.size() - at : (MAX_CONTENT & ~7);
+	record(&client->output, STDOUT, id, page.data() + at, length);
+	}
+record(&client->output, STDOUT, id, NULL, 0);
+end_request(&client->output, id, REQUEST_COMPLETE);
+
+if (!begun->keep_connection)
+	client->closing = true;
+client->request.erase(id);
+}
+
+/*
+	WEATHER_FASTCGI_SERVER::PROCESS()
+	---------------------------------
+	Act on each whole record the web server has sent.  The web server sends a request as FCGI_BEGIN_REQUEST,
+	the FCGI_PARAMS stream (the CGI environment), then the FCGI_STDIN stream (which we've no use for), and
+	records for different requests can be interleaved.
+*/
+void weather_fastcgi_server::process(weather_http_connection *connection)
+{
+weather_fastcgi_connection *client;
+std::map<uint16_t, weather_fastcgi_request>::iterator begun;
+const uint8_t *header;
+std::string content;
+size_t length, padding;
+uint16_t id;
+uint8_t type;
+char unknown[8];
+
+client = (weather_fastcgi_connection *)connection;
+while (!client->closing && client->input.size() >= HEADER_LENGTH)
+	{
+	header = (const uint8_t *)client->input.data();
+	if (header[0] != VERSION)
+		{
+		client->closing = true;			// not FastCGI (or not a version we know), so there's no talking to it
+		client->input.clear();
+		break;
+		}
+
+	type = header[1];
+	id = (header[2] << 8) | header[3];
+	length = (header[4] << 8) | header[5];
+	padding = header[6];
+	if (client->input.size() < HEADER_LENGTH + length + padding)
+		break;
+
+	content.assign(client->input, HEADER_LENGTH, length);
+	client->input.erase(0, HEADER_LENGTH + length + padding);
+
+	begun = client->request.find(id);
+	switch (type)
+		{
+		case BEGIN_REQUEST:
+			if (length < 8)
+				break;
+			if (((content[0] & 0xFF) << 8 | (content[1] & 0xFF)) != RESPONDER)
+				end_request(&client->output, id, UNKNOWN_ROLE);
+			else if ((long)client->request.size() >= MAX_REQUESTS)
+				end_request(&client->output, id, OVERLOADED);
+			else
+				{
+				client->request[id].params.clear();
+				client->request[id].keep_connection = content[2] & KEEP_CONN;
+				break;
+				}
+			if ((content[2] & KEEP_CONN) == 0)
+				client->closing = true;
+			break;
+		case ABORT_REQUEST:
+			if (begun == client->request.end())
+				break;
+			if (!begun->second.keep_connection)
+				client->closing = true;
+			client->request.erase(begun);
+			end_request(&client->output, id, REQUEST_COMPLETE);
+			break;
+		case PARAMS:
+			if (begun == client->request.end())
+				break;
+			begun->second.params += content;
+			if (begun->second.params.size() > MAX_REQUEST)
+				{
+				if (!begun->second.keep_connection)
+					client->closing = true;
+				client->request.erase(begun);
+				end_request(&client->output, id, OVERLOADED);
+				}
+			break;
+		case STDIN:
+			if (begun != client->request.end() && length == 0)
+				answer(client, id);
+			break;
+		case GET_VALUES:
+			get_values(client, &content);
+			break;
+		default:
+			/*
+				Management records (request id 0) we don't know must be answered, anything else we ignore
+			*/
+			if (id == 0)
+				{
+				memset(unknown, 0, sizeof(unknown));
+				unknown[0] = type;
+				record(&client->output, UNKNOWN_TYPE, 0, unknown, sizeof(unknown));
+				}
+			break;
+		}
+	}
+}
+
+#ifdef __linux__
+	/*
+		WEATHER_FASTCGI_SERVER::LAUNCHED_BY_WEB_SERVER()
+		------------------------------------------------
+		A web server that starts a FastCGI program itself (such as Apache's mod_fcgid) gives it the socket to take
+		connections from as its stdin (LISTEN_SOCKET) rather than a CGI request.  Returns true if that's how we were
+		started (see adopt()).
+	*/
+	long weather_fastcgi_server::launched_by_web_server(void)
+	{
+	int listening;
+	socklen_t length;
+
+	length = sizeof(listening);
+	if (getsockopt(LISTEN_SOCKET, SOL_SOCKET, SO_ACCEPTCONN, &listening, &length) != 0)
+		return false;
+
+	return listening != 0;
+	}
+#else
+	/*
+		WEATHER_FASTCGI_SERVER::LAUNCHED_BY_WEB_SERVER()
+		------------------------------------------------
+	*/
+	long weather_fastcgi_server::launched_by_web_server(void)
+	{
+	return false;
+	}
+#endif
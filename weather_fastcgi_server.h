@@ -0,0 +1,81 @@
+/*
+	WEATHER_FASTCGI_SERVER.H
+	------------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#ifndef WEATHER_FASTCGI_SERVER_H_
+#define WEATHER_FASTCGI_SERVER_H_
+
+#include <map>
+#include "weather_http_server.h"
+
+/*
+	class WEATHER_FASTCGI_REQUEST
+	-----------------------------
+	A request the web server has started (but not yet finished) sending us
+*/
+class weather_fastcgi_request
+{
+public:
+	std::string params;						// the FCGI_PARAMS stream so far (name-value pairs)
+	long keep_connection;					// true if the web server wants the connection left open afterwards
+} ;
+
+/*
+	class WEATHER_FASTCGI_CONNECTION
+	--------------------------------
+	A web server connected to the weather_fastcgi_server, which might be sending several requests at once
+*/
+class weather_fastcgi_connection : public weather_http_connection
+{
+public:
+	std::map<uint16_t, weather_fastcgi_request> request;		// indexed by request id
+} ;
+
+/*
+	class WEATHER_FASTCGI_SERVER
+	----------------------------
+	A FastCGI responder (so we can sit behind Apache or nginx as a long-lived process rather than a CGI
+	program).  The connections are handled just as weather_http_server does, but what comes over them is
+	FastCGI records, and requests can be multiplexed over one connection.  The handler's CGI output goes back
+	to the web server untouched.  Only on Linux.
+*/
+class weather_fastcgi_server : public weather_http_server
+{
+private:
+	static const uint8_t VERSION = 1;
+	static const size_t HEADER_LENGTH = 8;
+	static const size_t MAX_CONTENT = 0xFFFF;				// the most a record can carry
+	static const long MAX_REQUESTS = 100;					// at once on one connection
+
+	enum {BEGIN_REQUEST = 1, ABORT_REQUEST = 2, END_REQUEST = 3, PARAMS = 4, STDIN = 5, STDOUT = 6, STDERR = 7, DATA = 8, GET_VALUES = 9, GET_VALUES_RESULT = 10, UNKNOWN_TYPE = 11};
+	enum {RESPONDER = 1};
+	enum {KEEP_CONN = 1};
+	enum {REQUEST_COMPLETE = 0, CANT_MPX_CONN = 1, OVERLOADED = 2, UNKNOWN_ROLE = 3};
+
+public:
+	static const int LISTEN_SOCKET = 0;						// where the web server puts the socket it's listening on for us
+
+private:
+	static void record(std::string *into, uint8_t type, uint16_t id, const char *content, size_t length);
+	static void end_request(std::string *into, uint16_t id, uint8_t status);
+	static long next_pair(const std::string *from, size_t *at, std::string *name, std::string *value);
+	static size_t pair_length(const std::string *from, size_t *at);
+	static void add_pair(std::string *into, const char *name, const char *value);
+
+	void get_values(weather_fastcgi_connection *client, const std::string *content);
+	void answer(weather_fastcgi_connection *client, uint16_t id);
+
+protected:
+	virtual weather_http_connection *new_connection(void) { return new weather_fastcgi_connection; }
+	virtual void process(weather_http_connection *client);
+
+public:
+	weather_fastcgi_server(weather_http_handler handler, void *context = NULL) : weather_http_server(handler, context) {}
+	virtual ~weather_fastcgi_server() {}
+
+	static long launched_by_web_server(void);
+} ;
+
+#endif /* WEATHER_FASTCGI_SERVER_H_ */
@@ -0,0 +1,667 @@
+/*
+	WEATHER_HTTP_SERVER.C
+	---------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#ifdef __linux__
+	#include <sys/epoll.h>
+#endif
+#include "weather_http_server.h"
+
+/*
+	WEATHER_HTTP_REQUEST::CLEAR()
+	-----------------------------
+*/
+void weather_http_request::clear(void)
+{
+method.clear();
+path.clear();
+query_string.clear();
+user_agent.clear();
+if_none_match.clear();
+if_modified_since.clear();
+accept_encoding.clear();
+keep_alive = false;
+}
+
+/*
+	WEATHER_HTTP_REQUEST::NOT_MODIFIED()
+	------------------------------------
+	Does the client already have the page (whose entity tag is etag, and which last changed at last_modified)?
+	If-None-Match wins if the client sent both (RFC 7232), and its tags are compared weakly as it's a GET.
+	Returns true if a 304 will do.
+*/
+long weather_http_request::not_modified(const char *etag, time_t last_modified) const
+{
+std::string tag;
+size_t at, end, start;
+struct tm when;
+const char *parsed;
+
+if (!if_none_match.empty())
+	{
+	for (at = 0; at < if_none_match.size(); at = end + 1)
+		{
+		if ((end = if_none_match.find(',', at)) == std::string::npos)
+			end = if_none_match.size();
+		if ((start = if_none_match.find_first_not_of(" \t", at)) >= end)
+			continue;
+		tag = if_none_match.substr(start, if_none_match.find_last_not_of(" \t", end - 1) + 1 - start);
+
+		if (tag == "*")
+			return true;
+		if (tag.compare(0, 2, "W/") == 0)
+			tag.erase(0, 2);
+		if (tag == etag)
+			return true;
+		}
+	return false;
+	}
+
+if (!if_modified_since.empty())
+	{
+	memset(&when, 0, sizeof(when));
+	if ((parsed = strptime(if_modified_since.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &when)) == NULL || *parsed != '\0')
+		return false;		// not a date we understand (so it's as if it wasn't sent)
+	return last_modified <= timegm(&when);
+	}
+
+return false;
+}
+
+/*
+	WEATHER_HTTP_REQUEST::ENCODING()
+	--------------------------------
+	How would the client like the page compressed?  Returns "gzip" or "deflate" (whichever the client likes more,
+	gzip if it likes them the same), or NULL if it wants neither.
+*/
+const char *weather_http_request::encoding(void) const
+{
+std::string coding;
+size_t at, end, parameters;
+double quality, gzip, deflate, anything;
+const char *weight;
+
+gzip = deflate = anything = -1;			// not mentioned
+for (at = 0; at < accept_encoding.size(); at = end + 1)
+	{
+	if ((end = accept_encoding.find(',', at)) == std::string::npos)
+		end = accept_encoding.size();
+	coding = accept_encoding.substr(at, end - at);
+
+	/*
+		"coding" or "coding;q=0.5" (with spaces anywhere)
+	*/
+	quality = 1;
+	if ((parameters = coding.find(';')) != std::string::npos)
+		{
+		if ((weight = strstr(coding.c_str() + parameters, "q=")) != NULL)
+			quality = atof(weight + 2);
+		coding.erase(parameters);
+		}
+	coding.erase(0, coding.find_first_not_of(" \t") == std::string::npos ? coding.size() : coding.find_first_not_of(" \t"));
+	coding.erase(coding.find_last_not_of(" \t") + 1);
+
+	if (strcasecmp(coding.c_str(), "gzip") == 0 || strcasecmp(coding.c_str(), "x-gzip") == 0)
+		gzip = quality;
+	else if (strcasecmp(coding.c_str(), "deflate") == 0)
+		deflate = quality;
+	else if (coding == "*")
+		anything = quality;
+	}
+
+if (gzip < 0)
+	gzip = anything;
+if (deflate < 0)
+	deflate = anything;
+
+if (gzip > 0 && gzip >= deflate)
+	return "gzip";
+if (deflate > 0)
+	return "deflate";
+
+return NULL;
+}
+
+/*
+	WEATHER_HTTP_REQUEST::FORMAT_DATE()
+	-----------------------------------
+	Write when as an HTTP date (such as "Sun, 06 Nov 1994 08:49:37 GMT")
+*/
+void weather_http_request::format_date(char *into, size_t length, time_t when)
+{
+static const char *day[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+static const char *month[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+struct tm gmt;
+
+gmtime_r(&when, &gmt);
+snprintf(into, length, "%s, %02d %s %04d %02d:%02d:%02d GMT", day[gmt.tm_wday], gmt.tm_mday, month[gmt.tm_mon], gmt.tm_year + 1900, gmt.tm_hour, gmt.tm_min, gmt.tm_sec);
+}
+
+/*
+	WEATHER_HTTP_SERVER::WEATHER_HTTP_SERVER()
+	------------------------------------------
+*/
+weather_http_server::weather_http_server(weather_http_handler handler, void *context)
+{
+this->handler = handler;
+this->context = context;
+listener = events = -1;
+last_sweep = 0;
+}
+
+/*
+	WEATHER_HTTP_SERVER::~WEATHER_HTTP_SERVER()
+	-------------------------------------------
+*/
+weather_http_server::~weather_http_server()
+{
+size_t current;
+
+for (current = 0; current < connection.size(); current++)
+	if (connection[current] != NULL)
+		close_client(connection[current]);
+
+if (listener >= 0)
+	close(listener);
+if (events >= 0)
+	close(events);
+}
+
+/*
+	WEATHER_HTTP_SERVER::CLOSE_CLIENT()
+	-----------------------------------
+*/
+void weather_http_server::close_client(weather_http_connection *client)
+{
+close(client->fd);			// which also takes it out of the epoll set
+connection[client->fd] = NULL;
+delete client;
+}
+
+/*
+	WEATHER_HTTP_SERVER::PARSE()
+	----------------------------
+	Take the first request off the front of what the client has sent.  Returns 1 if there was a whole one
+	(which is now in request), 0 if we need more, and -1 if it's garbage.
+*/
+long weather_http_server::parse(weather_http_connection *client, weather_http_request *request)
+{
+size_t end, line_end, at, split, body_length, target_end;
+std::string line, version, connection_header, name, value;
+long first;
+
+/*
+	The headers end at the first blank line
+*/
+if ((end = client->input.find("\r\n\r\n")) != std::string::npos)
+	end += 4;
+else if ((end = client->input.find("\n\n")) != std::string::npos)
+	end += 2;
+else
+	return client->input.size() > MAX_REQUEST ? -1 : 0;
+
+request->clear();
+body_length = 0;
+first = true;
+for (at = 0; at < end; at = line_end + 1)
+	{
+	line_end = client->input.find('\n', at);
+	line = client->input.substr(at, line_end - at);
+	if (!line.empty() && line[line.size() - 1] == '\r')
+		line.erase(line.size() - 1);
+	if (line.empty())
+		continue;
+
+	if (first)
+		{
+		/*
+			The request line: method, target, version
+		*/
+		first = false;
+		if ((split = line.find(' ')) == std::string::npos || (target_end = line.find(' ', split + 1)) == std::string::npos)
+			return -1;
+		request->method = line.substr(0, split);
+		request->path = line.substr(split + 1, target_end - split - 1);
+		version = line.substr(target_end + 1);
+
+		if (request->path.compare(0, 7, "http://") == 0)
+			request->path.erase(0, request->path.find('/', 7) == std::string::npos ? request->path.size() : request->path.find('/', 7));
+		if ((split = request->path.find('?')) != std::string::npos)
+			{
+			request->query_string = request->path.substr(split + 1);
+			request->path.erase(split);
+			}
+		if (request->path.empty())
+			request->path = "/";
+		}
+	else
+		{
+		if ((split = line.find(':')) == std::string::npos)
+			return -1;
+		name = line.substr(0, split);
+		value = line.substr(line.find_first_not_of(" \t", split + 1) == std::string::npos ? line.size() : line.find_first_not_of(" \t", split + 1));
+
+		if (strcasecmp(name.c_str(), "Connection") == 0)
+			connection_header = value;
+		else if (strcasecmp(name.c_str(), "User-Agent") == 0)
+			request->user_agent = value;
+		else if (strcasecmp(name.c_str(), "If-None-Match") == 0)
+			request->if_none_match = value;
+		else if (strcasecmp(name.c_str(), "If-Modified-Since") == 0)
+			request->if_modified_since = value;
+		else if (strcasecmp(name.c_str(), "Accept-Encoding") == 0)
+			request->accept_encoding = value;
+		else if (strcasecmp(name.c_str(), "Content-Length") == 0)
+			body_length = strtoul(value.c_str(), NULL, 10);
+		}
+	}
+
+/*
+	HTTP/1.1 connections stay open unless the client says otherwise, HTTP/1.0 ones only if the client asks
+*/
+if (version == "HTTP/1.1")
+	request->keep_alive = strcasestr(connection_header.c_str(), "close") == NULL;
+else if (version == "HTTP/1.0")
+	request->keep_alive = strcasestr(connection_header.c_str(), "keep-alive") != NULL;
+else
+	return -1;
+
+/*
+	We've no use for a body, but it's still part of the request
+*/
+if (body_length > MAX_REQUEST)
+	return -1;
+if (client->input.size() < end + body_length)
+	return 0;
+
+client->input.erase(0, end + body_length);
+return 1;
+}
+
+/*
+	WEATHER_HTTP_SERVER::RESPOND()
+	------------------------------
+	Turn what a CGI program would have written into an HTTP reply (on the end of into).  A "Status:" line from the
+	CGI program overrides status.
+*/
+void weather_http_server::respond(std::string *into, const char *status, const std::string *cgi_output, long head_only, long keep_alive)
+{
+std::string headers, line, reply_status;
+size_t at, line_end, body;
+char length[32];
+
+reply_status = status;
+body = cgi_output->size();
+for (at = 0; at < cgi_output->size(); at = line_end + 1)
+	{
+	if ((line_end = cgi_output->find('\n', at)) == std::string::npos)
+		line_end = cgi_output->size();
+	line = cgi_output->substr(at, line_end - at);
+	if (!line.empty() && line[line.size() - 1] == '\r')
+		line.erase(line.size() - 1);
+
+	if (line.empty())
+		{
+		body = line_end + 1 < cgi_output->size() ? line_end + 1 : cgi_output->size();
+		break;
+		}
+	if (strncasecmp(line.c_str(), "Status:", 7) == 0)
+		reply_status = line.substr(line.find_first_not_of(" \t", 7) == std::string::npos ? line.size() : line.find_first_not_of(" \t", 7));
+	else
+		headers += line + "\r\n";
+	}
+
+*into += "HTTP/1.1 " + reply_status + "\r\n";
+*into += headers;
+
+/*
+	A 304 has no body, and the length it would have had isn't ours to say
+*/
+if (reply_status.compare(0, 3, "304") != 0)
+	{
+	snprintf(length, sizeof(length), "%lu", (unsigned long)(cgi_output->size() - body));
+	*into += "Content-Length: ";
+	*into += length;
+	*into += "\r\n";
+	}
+*into += keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+if (!head_only && reply_status.compare(0, 3, "304") != 0)
+	into->append(*cgi_output, body, std::string::npos);
+}
+
+/*
+	WEATHER_HTTP_SERVER::ANSWER()
+	-----------------------------
+*/
+void weather_http_server::answer(weather_http_connection *client, const weather_http_request *request)
+{
+std::string page;
+long head_only;
+
+head_only = request->method == "HEAD";
+if (request->method != "GET" && !head_only)
+	{
+	page = "Content-type: text/plain\n\nOnly GET and HEAD are supported\n";
+	respond(&client->output, "501 Not Implemented", &page, false, request->keep_alive);
+	}
+else
+	{
+	handler(context, request, &page);
+	respond(&client->output, "200 OK", &page, head_only, request->keep_alive);
+	}
+
+if (!request->keep_alive)
+	client->closing = true;
+}
+
+/*
+	WEATHER_HTTP_SERVER::PROCESS()
+	------------------------------
+	Answer the whole requests in what the client has sent, in the order they came (once we're hanging up we
+	ignore the rest)
+*/
+void weather_http_server::process(weather_http_connection *client)
+{
+weather_http_request request;
+long status;
+
+while (!client->closing && (status = parse(client, &request)) != 0)
+	{
+	if (status < 0)
+		{
+		std::string page = "Content-type: text/plain\n\nBad request\n";
+
+		respond(&client->output, "400 Bad Request", &page, false, false);
+		client->closing = true;
+		client->input.clear();
+		}
+	else
+		answer(client, &request);
+	}
+}
+
+#ifdef __linux__
+	/*
+		WEATHER_HTTP_SERVER::LISTEN()
+		-----------------------------
+		Listen for HTTP clients on the given TCP port (on every interface).  Return an error code (or 0 for success).
+	*/
+	uint32_t weather_http_server::listen(uint16_t port)
+	{
+	struct sockaddr_in address;
+	int file, yes = 1;
+
+	if ((file = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+		return 1;		// can't create a socket
+
+	setsockopt(file, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+	if (bind(file, (struct sockaddr *)&address, sizeof(address)) != 0)
+		{
+		close(file);
+		return 2;		// can't bind to the port
+		}
+
+	if (::listen(file, SOMAXCONN) != 0)
+		{
+		close(file);
+		return 3;		// can't listen
+		}
+
+	return adopt(file);
+	}
+
+	/*
+		WEATHER_HTTP_SERVER::ADOPT()
+		----------------------------
+		Take clients from a socket someone else is already listening on (such as the one a web server passes a
+		FastCGI program on stdin), which is now ours to close.  Return an error code (or 0 for success).
+	*/
+	uint32_t weather_http_server::adopt(int listening)
+	{
+	struct epoll_event event;
+
+	listener = listening;
+	fcntl(listener, F_SETFL, fcntl(listener, F_GETFL) | O_NONBLOCK);
+
+	if ((events = epoll_create(MAX_EVENTS)) < 0)
+		return 4;		// can't have an epoll instance
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = NULL;			// the listener is the only one without a connection
+	if (epoll_ctl(events, EPOLL_CTL_ADD, listener, &event) != 0)
+		return 4;
+
+	return 0;
+	}
+
+	/*
+		WEATHER_HTTP_SERVER::ACCEPT_CLIENTS()
+		-------------------------------------
+	*/
+	void weather_http_server::accept_clients(void)
+	{
+	weather_http_connection *client;
+	struct epoll_event event;
+	int file;
+
+	while ((file = accept(listener, NULL, NULL)) >= 0)
+		{
+		fcntl(file, F_SETFL, fcntl(file, F_GETFL) | O_NONBLOCK);
+
+		client = new_connection();
+		client->fd = file;
+		client->sent = 0;
+		client->closing = client->writing = false;
+		client->last_active = time(NULL);
+
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.ptr = client;
+		if (epoll_ctl(events, EPOLL_CTL_ADD, file, &event) != 0)
+			{
+			close(file);
+			delete client;
+			continue;
+			}
+
+		if ((size_t)file >= connection.size())
+			connection.resize(file + 1, NULL);
+		connection[file] = client;
+		}
+	}
+
+	/*
+		WEATHER_HTTP_SERVER::WATCH()
+		----------------------------
+		Wait for the client to send more, and (if writing) for it to be able to take more of what we have to send
+	*/
+	void weather_http_server::watch(weather_http_connection *client, long writing)
+	{
+	struct epoll_event event;
+
+	if (client->writing == writing)
+		return;
+
+	memset(&event, 0, sizeof(event));
+	event.events = writing ? EPOLLIN | EPOLLOUT : EPOLLIN;
+	event.data.ptr = client;
+	epoll_ctl(events, EPOLL_CTL_MOD, client->fd, &event);
+	client->writing = writing;
+	}
+
+	/*
+		WEATHER_HTTP_SERVER::WRITE_CLIENT()
+		-----------------------------------
+		Send as much of what we have for the client as it will take.  Returns false if we're done with the client.
+	*/
+	long weather_http_server::write_client(weather_http_connection *client)
+	{
+	ssize_t got;
+
+	while (client->sent < client->output.size())
+		{
+		if ((got = send(client->fd, client->output.data() + client->sent, client->output.size() - client->sent, MSG_NOSIGNAL)) < 0)
+			{
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				{
+				watch(client, true);
+				return true;
+				}
+			if (errno != EINTR)
+				return false;
+			}
+		else
+			{
+			client->sent += got;
+			client->last_active = time(NULL);
+			}
+		}
+
+	client->output.clear();
+	client->sent = 0;
+	watch(client, false);
+
+	return !client->closing;
+	}
+
+	/*
+		WEATHER_HTTP_SERVER::READ_CLIENT()
+		----------------------------------
+		Take whatever the client has sent and answer each whole request in it (see process()).  A client that has stopped sending
+		still gets its answers before we hang up.  Returns false if we're done with the client.
+	*/
+	long weather_http_server::read_client(weather_http_connection *client)
+	{
+	char buffer[4096];
+	ssize_t got;
+	long hung_up;
+
+	while ((got = recv(client->fd, buffer, sizeof(buffer), 0)) != 0)
+		{
+		if (got < 0)
+			{
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			if (errno != EINTR)
+				return false;
+			}
+		else
+			client->input.append(buffer, got);
+		}
+
+	hung_up = got == 0;
+	client->last_active = time(NULL);
+
+	process(client);
+
+	if (hung_up)
+		client->closing = true;
+
+	return write_client(client);
+	}
+
+	/*
+		WEATHER_HTTP_SERVER::SWEEP()
+		----------------------------
+		Hang up on clients that have been idle too long
+	*/
+	void weather_http_server::sweep(time_t now)
+	{
+	size_t current;
+
+	for (current = 0; current < connection.size(); current++)
+		if (connection[current] != NULL && now - connection[current]->last_active > IDLE_TIMEOUT)
+			close_client(connection[current]);
+
+	last_sweep = now;
+	}
+
+	/*
+		WEATHER_HTTP_SERVER::RUN()
+		--------------------------
+		Serve clients forever.  Returns non-zero if we can't.
+	*/
+	uint32_t weather_http_server::run(void)
+	{
+	struct epoll_event event[MAX_EVENTS];
+	weather_http_connection *client;
+	long ready, current, alive;
+	time_t now;
+
+	if (events < 0)
+		return 1;		// not listening
+
+	for (;;)
+		{
+		if ((ready = epoll_wait(events, event, MAX_EVENTS, 1000)) < 0)
+			{
+			if (errno == EINTR)
+				continue;
+			return 1;
+			}
+
+		for (current = 0; current < ready; current++)
+			if ((client = (weather_http_connection *)event[current].data.ptr) == NULL)
+				accept_clients();
+			else
+				{
+				alive = true;
+				if (event[current].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+					alive = read_client(client);
+				if (alive && (event[current].events & EPOLLOUT))
+					alive = write_client(client);
+				if (!alive)
+					close_client(client);
+				}
+
+		if ((now = time(NULL)) != last_sweep)
+			sweep(now);
+		}
+
+	return 0;
+	}
+#else
+	/*
+		WEATHER_HTTP_SERVER::LISTEN()
+		-----------------------------
+	*/
+	uint32_t weather_http_server::listen(uint16_t port)
+	{
+	return 4;		// not supported (there's no epoll)
+	}
+
+	/*
+		WEATHER_HTTP_SERVER::ADOPT()
+		----------------------------
+	*/
+	uint32_t weather_http_server::adopt(int listening)
+	{
+	return 4;		// not supported
+	}
+
+	/*
+		WEATHER_HTTP_SERVER::RUN()
+		--------------------------
+	*/
+	uint32_t weather_http_server::run(void)
+	{
+	return 1;		// not supported
+	}
+#endif
@@ -0,0 +1,114 @@
+/*
+	WEATHER_HTTP_SERVER.H
+	---------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#ifndef WEATHER_HTTP_SERVER_H_
+#define WEATHER_HTTP_SERVER_H_
+
+#include <time.h>
+#include <string>
+#include <vector>
+#include "fundamental_types.h"
+
+/*
+	class WEATHER_HTTP_REQUEST
+	--------------------------
+	What a client asked for (the parts of it a page needs)
+*/
+class weather_http_request
+{
+public:
+	std::string method;						// "GET" or "HEAD"
+	std::string path;						// without the query string
+	std::string query_string;				// what follows the '?' ("" if nothing)
+	std::string user_agent;					// "" if the client didn't say
+	std::string if_none_match;				// the client's If-None-Match header ("" if it didn't send one)
+	std::string if_modified_since;			// the client's If-Modified-Since header ("" if it didn't send one)
+	std::string accept_encoding;			// the client's Accept-Encoding header ("" if it didn't send one)
+	long keep_alive;						// true if the connection stays open after the reply
+
+public:
+	void clear(void);
+	long not_modified(const char *etag, time_t last_modified) const;
+	const char *encoding(void) const;
+
+	static void format_date(char *into, size_t length, time_t when);
+} ;
+
+/*
+	WEATHER_HTTP_HANDLER
+	--------------------
+	Called by weather_http_server for each request.  The reply is written into response exactly as a CGI
+	program would write it to stdout: header lines (at least "Content-type:"), a blank line, then the body.
+*/
+typedef void (*weather_http_handler)(void *context, const weather_http_request *request, std::string *response);
+
+/*
+	class WEATHER_HTTP_CONNECTION
+	-----------------------------
+	One client of the weather_http_server
+*/
+class weather_http_connection
+{
+public:
+	int fd;
+	std::string input;						// recieved but not yet answered
+	std::string output;						// replies not yet sent
+	size_t sent;							// bytes of output already sent
+	long closing;							// true if we hang up once output has been sent
+	long writing;							// true if we're waiting to be able to send the rest of output
+	time_t last_active;
+
+public:
+	virtual ~weather_http_connection() {}
+} ;
+
+/*
+	class WEATHER_HTTP_SERVER
+	-------------------------
+	A single threaded, event driven (epoll) HTTP/1.1 server that answers GET and HEAD requests by calling the
+	handler.  Connections are kept alive (and requests may be pipelined) unless the client says otherwise, and
+	are closed once they've been idle for IDLE_TIMEOUT seconds.  Only on Linux.
+*/
+class weather_http_server
+{
+protected:
+	static const long MAX_EVENTS = 64;
+	static const size_t MAX_REQUEST = 16 * 1024;		// the longest request (headers included) we'll take
+	static const time_t IDLE_TIMEOUT = 30;				// seconds a kept-alive connection can sit idle
+
+protected:
+	int listener;
+	int events;										// the epoll instance
+	weather_http_handler handler;
+	void *context;
+	std::vector<weather_http_connection *> connection;	// indexed by file descriptor
+	time_t last_sweep;
+
+private:
+	void accept_clients(void);
+	void close_client(weather_http_connection *client);
+	long parse(weather_http_connection *client, weather_http_request *request);
+	void answer(weather_http_connection *client, const weather_http_request *request);
+	static void respond(std::string *into, const char *status, const std::string *cgi_output, long head_only, long keep_alive);
+	long read_client(weather_http_connection *client);
+	long write_client(weather_http_connection *client);
+	void watch(weather_http_connection *client, long writing);
+	void sweep(time_t now);
+
+protected:
+	virtual weather_http_connection *new_connection(void) { return new weather_http_connection; }
+	virtual void process(weather_http_connection *client);
+
+public:
+	weather_http_server(weather_http_handler handler, void *context = NULL);
+	virtual ~weather_http_server();
+
+	uint32_t listen(uint16_t port);
+	uint32_t adopt(int listening);
+	uint32_t run(void);
+} ;
+
+#endif /* WEATHER_HTTP_SERVER_H_ */
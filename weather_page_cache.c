@@ -0,0 +1,152 @@
+/*
+	WEATHER_PAGE_CACHE.C
+	--------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#include <string.h>
+#include <zlib.h>
+#include "weather_page_cache.h"
+
+/*
+	WEATHER_PAGE_CACHE::COMPRESS()
+	------------------------------
+	Put from (from start to its end) into into, gzipped or (if not gzip) deflated in zlib format.  into is left
+	empty if it can't be done.
+*/
+void weather_page_cache::compress(std::string *into, const std::string *from, size_t start, long gzip)
+{
+z_stream stream;
+
+memset(&stream, 0, sizeof(stream));
+if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, gzip ? 15 + 16 : 15, 8, Z_DEFAULT_STRATEGY) != Z_OK)		// +16 for a gzip wrapper
+	{
+	into->clear();
+	return;
+	}
+
+into->resize(deflateBound(&stream, from->size() - start));
+stream.next_in = (Bytef *)from->data() + start;
+stream.avail_in = from->size() - start;
+stream.next_out = (Bytef *)&(*into)[0];
+stream.avail_out = into->size();
+
+if (deflate(&stream, Z_FINISH) == Z_STREAM_END)
+	into->resize(stream.total_out);
+else
+	into->clear();
+
+deflateEnd(&stream);
+}
+
+/*
+	WEATHER_PAGE_CACHE::VARIANT()
+	-----------------------------
+	Put the page in entry into into, with its body compressed as encoding ("gzip", "deflate", or NULL for as it
+	is) if we have it that way
+*/
+void weather_page_cache::variant(std::string *into, const weather_page_cache_entry *entry, const char *encoding)
+{
+const std::string *body;
+
+if (encoding != NULL && strcmp(encoding, "gzip") == 0)
+	body = &entry->gzip;
+else if (encoding != NULL && strcmp(encoding, "deflate") == 0)
+	body = &entry->deflate;
+else
+	body = NULL;
+
+if (body == NULL || body->empty())
+	{
+	*into = entry->page;
+	return;
+	}
+
+/*
+	The page's headers (without the blank line after them), then ours, then the compressed body
+*/
+into->assign(entry->page, 0, entry->body - 1);
+*into += "Content-Encoding: ";
+*into += encoding;
+*into += "\n\n";
+*into += *body;
+}
+
+/*
+	WEATHER_PAGE_CACHE::FIND()
+	--------------------------
+	Get the page called name if it was rendered when the station was at version (and isn't too old), compressed
+	as encoding (see variant()).  Returns true (with the page in page) if so.
+*/
+long weather_page_cache::find(const std::string *name, const std::string *version, const char *encoding, std::string *page)
+{
+std::map<std::string, weather_page_cache_entry>::iterator found;
+
+if ((found = pages.find(*name)) == pages.end() || found->second.version != *version || time(NULL) - found->second.rendered >= MAX_AGE)
+	{
+	misses++;
+	return false;
+	}
+
+hits++;
+variant(page, &found->second, encoding);
+
+return true;
+}
+
+/*
+	WEATHER_PAGE_CACHE::STORE()
+	---------------------------
+	Keep the page called name, as rendered when the station was at version.  If asked, put the page compressed as
+	encoding into answer (see variant()).
+*/
+void weather_page_cache::store(const std::string *name, const std::string *version, const std::string *page, const char *encoding, std::string *answer)
+{
+weather_page_cache_entry *entry;
+
+/*
+	Once we're full start again (whatever we had is probably out of date by now anyway)
+*/
+if (pages.size() >= MAX_PAGES && pages.find(*name) == pages.end())
+	pages.clear();
+
+entry = &pages[*name];
+entry->version = *version;
+entry->page = *page;
+entry->rendered = time(NULL);
+
+/*
+	Compress the body (if it's long enough to be worth it, and only keep what comes out smaller)
+*/
+entry->gzip.clear();
+entry->deflate.clear();
+if ((entry->body = page->find("\n\n")) != std::string::npos && page->size() - (entry->body += 2) >= MIN_COMPRESS)
+	{
+	compress(&entry->gzip, page, entry->body, true);
+	if (entry->gzip.size() >= page->size() - entry->body)
+		entry->gzip.clear();
+	compress(&entry->deflate, page, entry->body, false);
+	if (entry->deflate.size() >= page->size() - entry->body)
+		entry->deflate.clear();
+	}
+
+if (answer != NULL)
+	variant(answer, entry, encoding);
+}
+
+/*
+	WEATHER_PAGE_CACHE::CHANGED()
+	-----------------------------
+	When did the station get to version?  We can only say when we first saw it, which is as good as it gets as the
+	station's clock only counts minutes (and it writes more often than that).
+*/
+time_t weather_page_cache::changed(const std::string *version)
+{
+if (*version != latest_version)
+	{
+	latest_version = *version;
+	latest_change = time(NULL);
+	}
+
+return latest_change;
+}
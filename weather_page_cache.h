@@ -0,0 +1,69 @@
+/*
+	WEATHER_PAGE_CACHE.H
+	--------------------
+	Copyright (c) 2014 Andrew Trotman
+	Licensed BSD
+*/
+#ifndef WEATHER_PAGE_CACHE_H_
+#define WEATHER_PAGE_CACHE_H_
+
+#include <time.h>
+#include <map>
+#include <string>
+#include "fundamental_types.h"
+
+/*
+	class WEATHER_PAGE_CACHE_ENTRY
+	------------------------------
+*/
+class weather_page_cache_entry
+{
+public:
+	std::string version;					// what the station looked like when the page was rendered
+	std::string page;						// the page (as a CGI program writes it)
+	size_t body;							// where the page's body starts (after its headers and the blank line)
+	std::string gzip;						// the body gzipped ("" if that wouldn't make it smaller)
+	std::string deflate;					// the body deflated (in zlib format, as HTTP's "deflate" is)
+	time_t rendered;						// when
+} ;
+
+/*
+	class WEATHER_PAGE_CACHE
+	------------------------
+	Pages we've already rendered.  A page only changes when the station does, so each is kept along with the
+	station's version (any bytes that change whenever the station does) and is good until that changes.  Pages
+	are also dropped after MAX_AGE seconds, so that anything else they depend on (such as daylight saving) can't
+	leave them stale for long.  The body of each page is compressed once, when it's stored, so every client that
+	takes a compressed page gets the one copy.
+*/
+class weather_page_cache
+{
+private:
+	static const size_t MAX_PAGES = 64;				// names come from clients, so don't keep them all
+	static const time_t MAX_AGE = 300;
+	static const size_t MIN_COMPRESS = 256;			// bodies shorter than this are sent as they are
+
+private:
+	std::map<std::string, weather_page_cache_entry> pages;	// indexed by name
+	uint32_t hits, misses;
+	std::string latest_version;								// the station's version when we last looked
+	time_t latest_change;									// when we first saw it
+
+private:
+	static void compress(std::string *into, const std::string *from, size_t start, long gzip);
+	static void variant(std::string *into, const weather_page_cache_entry *entry, const char *encoding);
+
+public:
+	weather_page_cache() { hits = misses = 0; latest_change = 0; }
+	virtual ~weather_page_cache() {}
+
+	long find(const std::string *name, const std::string *version, const char *encoding, std::string *page);
+	void store(const std::string *name, const std::string *version, const std::string *page, const char *encoding = NULL, std::string *answer = NULL);
+	time_t changed(const std::string *version);
+	void clear(void) { pages.clear(); }
+
+	uint32_t get_hits(void) { return hits; }
+	uint32_t get_misses(void) { return misses; }
+} ;
+
+#endif /* WEATHER_PAGE_CACHE_H_ */